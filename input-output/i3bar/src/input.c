@@ -24,6 +24,7 @@
 
 #include <string.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -48,9 +49,25 @@
 
 #define yajl_strcmp(str1, len1, str2) ( ( strlen(str2) == len1 ) && ( g_ascii_strncasecmp((const gchar *) str1, str2, len1) == 0 ) )
 
+#define DEFAULT_HEADER_TIMEOUT 5
+#define DEFAULT_RESTART_DELAY 1
+#define DEFAULT_RESTART_MAX_DELAY 300
+#define RESTART_STABLE_TIME 60
+#define USAGE_INTERVAL 5
+#define READ_BUFFER_SIZE 65536
+#define STDERR_RING_SIZE 4096
+#define EVENTS_QUEUE_SIZE 16
+
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     GList *clients;
+    gboolean started;
+    guint header_timeout;
+    guint restart_delay;
+    guint restart_max_delay;
+    guint usage_timeout;
+    guint pending;
+    gint64 init_time;
 };
 
 typedef enum {
@@ -131,11 +148,44 @@ typedef struct {
 typedef struct {
     J4statusPluginContext *context;
     GList *link;
+    guint index;
     gchar *name;
+    gchar **argv;
     GPid pid;
+    guint child_watch;
+    gint64 spawn_time;
+    gboolean handshake;
+    gint stdin_fd;
+    guint header_timeout;
+    guint64 skipped;
+    struct {
+        guint timeout;
+        guint delay;
+        guint count;
+    } restart;
+    struct {
+        guint64 cpu_time;
+        guint64 run_cpu_time;
+        guint64 rss;
+        guint64 max_rss;
+    } usage;
+    struct {
+        gchar buffer[STDERR_RING_SIZE];
+        gsize end;
+        gsize length;
+        gchar chunk[1024];
+    } stderr_ring;
+    struct {
+        GQueue queue;
+        gsize offset;
+        gboolean writing;
+        gboolean first;
+        guint64 coalesced;
+        guint64 dropped;
+    } events;
     GOutputStream *stdin;
     GDataInputStream *stdout;
-    GDataInputStream *stderr;
+    GInputStream *stderr;
     GCancellable *cancellable;
     gint stop_signal;
     gint cont_signal;
@@ -145,30 +195,134 @@ typedef struct {
     GHashTable *sections;
 } J4statusI3barInputClient;
 
+static void
+_j4status_i3bar_input_client_events_clear(J4statusI3barInputClient *client)
+{
+    GBytes *event;
+    while ( ( event = g_queue_pop_head(&client->events.queue) ) != NULL )
+        g_bytes_unref(event);
+    client->events.offset = 0;
+    client->events.writing = FALSE;
+    client->events.first = FALSE;
+}
+
+static void _j4status_i3bar_input_client_write_next(J4statusI3barInputClient *client);
+
+static void
+_j4status_i3bar_input_client_write_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
+    GError *error = NULL;
+
+    gssize size;
+    size = g_output_stream_write_finish(G_OUTPUT_STREAM(source_object), res, &error);
+    if ( (gpointer) source_object != client->stdin )
+    {
+        /* Leftover from a previous run */
+        g_clear_error(&error);
+        return;
+    }
+    client->events.writing = FALSE;
+
+    if ( size < 0 )
+    {
+        g_warning("Couldn't write event to client '%s': %s", client->name, error->message);
+        g_clear_error(&error);
+        _j4status_i3bar_input_client_events_clear(client);
+        yajl_gen_free(client->json_gen);
+        client->json_gen = NULL;
+        g_clear_object(&client->stdin);
+        return;
+    }
+
+    client->events.offset += size;
+    if ( client->events.offset == g_bytes_get_size(g_queue_peek_head(&client->events.queue)) )
+    {
+        g_bytes_unref(g_queue_pop_head(&client->events.queue));
+        client->events.offset = 0;
+    }
+
+    _j4status_i3bar_input_client_write_next(client);
+}
+
+static void
+_j4status_i3bar_input_client_write_next(J4statusI3barInputClient *client)
+{
+    if ( client->events.writing )
+        return;
+
+    GBytes *event = g_queue_peek_head(&client->events.queue);
+    if ( event == NULL )
+        return;
+
+    gsize size;
+    const gchar *data = g_bytes_get_data(event, &size);
+
+    /* Events are queued with their leading comma, the first one must not have it */
+    if ( ( client->events.offset == 0 ) && ( *data == ',' ) )
+    {
+        if ( client->events.first )
+            client->events.offset = 1;
+        client->events.first = FALSE;
+    }
+
+    client->events.writing = TRUE;
+    g_output_stream_write_async(client->stdin, data + client->events.offset, size - client->events.offset, G_PRIORITY_DEFAULT, client->cancellable, _j4status_i3bar_input_client_write_callback, client);
+}
+
+/*
+ * The head of the queue is the one being written
+ * If the client does not keep up, repeated events are merged
+ * and the oldest ones are dropped
+ */
 static void
 _j4status_i3bar_input_client_write(J4statusI3barInputClient *client)
 {
-        const unsigned char *output;
-        size_t size;
-        GError *error = NULL;
-        yajl_gen_get_buf(client->json_gen, &output, &size);
-        if ( g_output_stream_write_all(client->stdin, output, size, NULL, NULL, &error) )
-            g_output_stream_write_all(client->stdin, "\n", 1, NULL, NULL, &error);
-        yajl_gen_clear(client->json_gen);
-        if ( error != NULL )
-        {
-            g_warning("Couldn't write event header from client '%s': %s", client->name, error->message);
-            yajl_gen_free(client->json_gen);
-            client->json_gen = NULL;
-            g_object_unref(client->stdin);
-            client->stdin = NULL;
-        }
+    const unsigned char *output;
+    size_t size;
+    yajl_gen_get_buf(client->json_gen, &output, &size);
+
+    gchar *data;
+    gsize o = 0;
+    data = g_new(gchar, size + 2);
+    if ( *output != ',' )
+        data[o++] = ',';
+    memcpy(data + o, output, size);
+    o += size;
+    data[o++] = '\n';
+    yajl_gen_clear(client->json_gen);
+
+    GBytes *event, *last;
+    event = g_bytes_new_take(data, o);
+
+    last = g_queue_peek_tail(&client->events.queue);
+    if ( ( last != NULL ) && ( ( ! client->events.writing ) || ( g_queue_get_length(&client->events.queue) > 1 ) ) && g_bytes_equal(last, event) )
+    {
+        ++client->events.coalesced;
+        g_bytes_unref(event);
+        return;
+    }
+
+    if ( g_queue_get_length(&client->events.queue) >= EVENTS_QUEUE_SIZE )
+    {
+        g_debug("Client '%s' is not reading its events, dropping one", client->name);
+        ++client->events.dropped;
+        g_bytes_unref(g_queue_pop_nth(&client->events.queue, client->events.writing ? 1 : 0));
+    }
+
+    g_queue_push_tail(&client->events.queue, event);
+    _j4status_i3bar_input_client_write_next(client);
 }
+
 static void
 _j4status_i3bar_input_client_action_callback(J4statusSection *section, const gchar *event_id, gpointer user_data)
 {
     J4statusI3barInputClient *client = user_data;
 
+    if ( client->json_gen == NULL )
+        /* Client is dead or restarting */
+        return;
+
     if ( ! g_str_has_prefix(event_id, "mouse:") )
         return;
 
@@ -441,6 +595,16 @@ _j4status_i3bar_input_section_map_key(void *user_data, const unsigned char *valu
     return 0;
 }
 
+static gboolean
+_j4status_i3bar_input_colour_equal(J4statusColour a, J4statusColour b)
+{
+    if ( a.set != b.set )
+        return FALSE;
+    if ( ! a.set )
+        return TRUE;
+    return ( a.red == b.red ) && ( a.green == b.green ) && ( a.blue == b.blue ) && ( a.alpha == b.alpha );
+}
+
 static int
 _j4status_i3bar_input_section_end_map(void *user_data)
 {
@@ -508,17 +672,30 @@ _j4status_i3bar_input_section_end_map(void *user_data)
         }
     }
 
+    /* Clients resend everything, we only touch what actually changed */
     J4statusState state = J4STATUS_STATE_NO_STATE;
     if ( client->parse_context.urgent )
         state |= J4STATUS_STATE_URGENT;
+    if ( j4status_section_get_state(section) != state )
+        j4status_section_set_state(section, state);
 
-    j4status_section_set_state(section, state);
-    j4status_section_set_value(section, client->parse_context.full_text);
-    client->parse_context.full_text = NULL;
-    j4status_section_set_short_value(section, client->parse_context.short_text);
-    client->parse_context.short_text = NULL;
-    j4status_section_set_colour(section, client->parse_context.colour);
-    j4status_section_set_background_colour(section, client->parse_context.background);
+    const gchar *full_text = client->parse_context.full_text;
+    if ( ( full_text != NULL ) && ( *full_text == '\0' ) )
+        full_text = NULL;
+    if ( g_strcmp0(j4status_section_get_value(section), full_text) != 0 )
+    {
+        j4status_section_set_value(section, client->parse_context.full_text);
+        client->parse_context.full_text = NULL;
+    }
+    if ( g_strcmp0(j4status_section_get_short_value(section), client->parse_context.short_text) != 0 )
+    {
+        j4status_section_set_short_value(section, client->parse_context.short_text);
+        client->parse_context.short_text = NULL;
+    }
+    if ( ! _j4status_i3bar_input_colour_equal(j4status_section_get_colour(section), client->parse_context.colour) )
+        j4status_section_set_colour(section, client->parse_context.colour);
+    if ( ! _j4status_i3bar_input_colour_equal(j4status_section_get_background_colour(section), client->parse_context.background) )
+        j4status_section_set_background_colour(section, client->parse_context.background);
 
 end:
     client->parse_context.in_section = FALSE;
@@ -577,7 +754,78 @@ static yajl_callbacks _j4status_i3bar_input_section_callbacks = {
     .yajl_end_array   = _j4status_i3bar_input_section_end_array,
 };
 
-static void _j4status_i3bar_input_client_free(gpointer data);
+static void _j4status_i3bar_input_client_kill(J4statusI3barInputClient *client);
+
+static gboolean
+_j4status_i3bar_input_client_parse(J4statusI3barInputClient *client, const gchar *line, gsize length)
+{
+    yajl_status json_state;
+
+    json_state = yajl_parse(client->json_handle, (const unsigned char *) line, length);
+
+    if ( json_state == yajl_status_ok )
+        return TRUE;
+
+    /* The parse context is cleaned up when the client is reset */
+    if ( json_state == yajl_status_error )
+    {
+        unsigned char *str_error;
+        str_error = yajl_get_error(client->json_handle, 0, (const unsigned char *) line, length);
+        g_warning("Couldn't parse section from client '%s': %s", client->name, str_error);
+        yajl_free_error(client->json_handle, str_error);
+    }
+    else if ( json_state == yajl_status_client_canceled )
+    {
+        g_warning("i3bar JSON protocol section error from client '%s': %s", client->name, client->parse_context.error);
+    }
+
+    return FALSE;
+}
+
+/*
+ * Checks if line is a whole frame, i.e. "[…]" with a comma before or after,
+ * as clients usually send them
+ */
+static gboolean
+_j4status_i3bar_input_is_frame(const gchar *line, gsize length, gboolean *leading_comma, gboolean *trailing_comma)
+{
+    const gchar *s = line, *e = line + length;
+
+    while ( ( s < e ) && g_ascii_isspace(*s) )
+        ++s;
+    while ( ( e > s ) && g_ascii_isspace(e[-1]) )
+        --e;
+
+    *leading_comma = ( ( s < e ) && ( *s == ',' ) );
+    if ( *leading_comma )
+    {
+        ++s;
+        while ( ( s < e ) && g_ascii_isspace(*s) )
+            ++s;
+    }
+    *trailing_comma = ( ( e > s ) && ( e[-1] == ',' ) );
+    if ( *trailing_comma )
+    {
+        --e;
+        while ( ( e > s ) && g_ascii_isspace(e[-1]) )
+            --e;
+    }
+
+    return ( ( ( e - s ) >= 2 ) && ( *s == '[' ) && ( e[-1] == ']' ) );
+}
+
+/* Only returns a line if it is already in our buffer, so never blocks */
+static gchar *
+_j4status_i3bar_input_client_read_buffered_line(J4statusI3barInputClient *client, gsize *length, GError **error)
+{
+    gsize available;
+    const gchar *buffer;
+    buffer = g_buffered_input_stream_peek_buffer(G_BUFFERED_INPUT_STREAM(client->stdout), &available);
+    if ( memchr(buffer, '\n', available) == NULL )
+        return NULL;
+
+    return g_data_input_stream_read_line_utf8(client->stdout, length, NULL, error);
+}
 
 static void
 _j4status_i3bar_input_client_read_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
@@ -587,87 +835,101 @@ _j4status_i3bar_input_client_read_callback(GObject *source_object, GAsyncResult
 
     gchar *line;
     gsize length;
-    line = g_data_input_stream_read_line_finish_utf8(client->stdout, res, &length, &error);
+    line = g_data_input_stream_read_line_finish_utf8(G_DATA_INPUT_STREAM(source_object), res, &length, &error);
+    if ( (gpointer) source_object != client->stdout )
+    {
+        /* Leftover from a previous run */
+        g_free(line);
+        g_clear_error(&error);
+        return;
+    }
     if ( line == NULL )
     {
         if ( error == NULL )
-            /* EOF, we keep things around, client will be freed later */
+            /* EOF, the child watch will take care of the rest */
             return;
 
         g_warning("Couldn't read client '%s' output: %s", client->name, error->message);
         g_clear_error(&error);
-        _j4status_i3bar_input_client_free(client);
+        _j4status_i3bar_input_client_kill(client);
         return;
     }
 
-    yajl_status json_state;
-
-    json_state = yajl_parse(client->json_handle, (const unsigned char *) line, length);
-
-    if ( json_state != yajl_status_ok )
+    /*
+     * If the client is faster than us, we only parse the latest frame.
+     * Older ones are replaced by an empty frame to keep the parser state.
+     */
+    gchar *next;
+    gsize next_length;
+    while ( ( next = _j4status_i3bar_input_client_read_buffered_line(client, &next_length, &error) ) != NULL )
     {
-        g_free(client->parse_context.name);
-        g_free(client->parse_context.instance);
-        g_free(client->parse_context.full_text);
-
-        if ( json_state == yajl_status_error )
+        gboolean leading_comma, trailing_comma, r;
+        if ( ( client->parse_context.array_nesting == 1 ) && _j4status_i3bar_input_is_frame(line, length, &leading_comma, &trailing_comma) && _j4status_i3bar_input_is_frame(next, next_length, &r, &r) )
         {
-            unsigned char *str_error;
-            str_error = yajl_get_error(client->json_handle, 0, (const unsigned char *) line, length);
-            g_warning("Couldn't parse section from client '%s': %s", client->name, str_error);
-            yajl_free_error(client->json_handle, str_error);
+            gchar empty[4];
+            gsize l = 0;
+            if ( leading_comma )
+                empty[l++] = ',';
+            empty[l++] = '[';
+            empty[l++] = ']';
+            if ( trailing_comma )
+                empty[l++] = ',';
+            ++client->skipped;
+            r = _j4status_i3bar_input_client_parse(client, empty, l);
         }
-        else if ( json_state == yajl_status_client_canceled )
+        else
+            r = _j4status_i3bar_input_client_parse(client, line, length);
+
+        g_free(line);
+        line = next;
+        length = next_length;
+
+        if ( ! r )
         {
-            g_warning("i3bar JSON protocol section error from client '%s': %s", client->name, client->parse_context.error);
-            g_free(client->parse_context.error);
+            g_free(line);
+            _j4status_i3bar_input_client_kill(client);
+            return;
         }
+    }
+    if ( error != NULL )
+    {
+        g_warning("Couldn't read client '%s' output: %s", client->name, error->message);
+        g_clear_error(&error);
+        g_free(line);
+        _j4status_i3bar_input_client_kill(client);
+        return;
+    }
 
-        _j4status_i3bar_input_client_free(client);
+    gboolean r;
+    r = _j4status_i3bar_input_client_parse(client, line, length);
+    g_free(line);
+    if ( ! r )
+    {
+        _j4status_i3bar_input_client_kill(client);
         return;
     }
 
     g_data_input_stream_read_line_async(client->stdout, G_PRIORITY_DEFAULT, client->cancellable, _j4status_i3bar_input_client_read_callback, client);
 }
 
-static J4statusI3barInputClient *
-_j4status_i3bar_input_client_new(J4statusPluginContext *context, const gchar *client_command)
+static void
+_j4status_i3bar_input_client_handshake_done(J4statusI3barInputClient *client)
 {
-    GError *error = NULL;
-    J4statusI3barInputClient *client = NULL;
-
-    gchar **argv = NULL;
-    if ( ! g_shell_parse_argv(client_command, NULL, &argv, &error) )
-    {
-        g_warning("Couldn't parse '%s': %s", client_command, error->message);
-        goto fail;
-    }
+    J4statusPluginContext *context = client->context;
 
-    client = g_new0(J4statusI3barInputClient, 1);
-    client->context = context;
-    client->name = g_path_get_basename(argv[0]);
-
-    gint child_stdin_fd, child_stdout_fd, child_stderr_fd;
-    if ( ! g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, &client->pid, &child_stdin_fd, &child_stdout_fd, &child_stderr_fd, &error) )
-    {
-        g_warning("Couldn't spawn '%s': %s", client->name, error->message);
-        goto fail;
-    }
+    if ( ! client->handshake )
+        return;
+    client->handshake = FALSE;
 
-    GInputStream *raw_in;
-    raw_in = stream_from_fd(in, child_stdout_fd);
-    client->stdout = g_data_input_stream_new(raw_in);
-    g_object_unref(raw_in);
+    if ( --context->pending > 0 )
+        return;
 
-    gchar *header;
-    gsize length = 0;
-    header = g_data_input_stream_read_line_utf8(client->stdout, &length, NULL, &error);
-    if ( header == NULL )
-    {
-        g_warning("Couldn't read header from client '%s': %s", client->name, error->message);
-        goto fail;
-    }
+    g_debug("All clients done with their header after %" G_GINT64_FORMAT "ms", ( g_get_monotonic_time() - context->init_time ) / 1000);
+}
 
+static gboolean
+_j4status_i3bar_input_client_parse_header(J4statusI3barInputClient *client, const gchar *header, gsize length)
+{
     J4statusI3barInputHeaderParseContext header_context = {0};
     yajl_handle json_handle;
     yajl_status json_state;
@@ -680,94 +942,448 @@ _j4status_i3bar_input_client_new(J4statusPluginContext *context, const gchar *cl
         if ( json_state == yajl_status_error )
         {
             unsigned char *str_error;
-            str_error = yajl_get_error(client->json_handle, 0, (const unsigned char *) header, length);
+            str_error = yajl_get_error(json_handle, 0, (const unsigned char *) header, length);
             g_warning("Couldn't parse header from client '%s': %s", client->name, str_error);
-            yajl_free_error(client->json_handle, str_error);
+            yajl_free_error(json_handle, str_error);
         }
         else if ( json_state == yajl_status_client_canceled )
         {
             g_warning("i3bar JSON protocol header error from client '%s': %s", client->name, header_context.error);
-            g_free(client->parse_context.error);
+            g_free(header_context.error);
         }
 
         yajl_free(json_handle);
-        goto fail;
+        return FALSE;
     }
+    yajl_free(json_handle);
 
     client->stop_signal = header_context.stop_signal;
     client->cont_signal = header_context.cont_signal;
 
     if ( header_context.click_events )
-        client->stdin = stream_from_fd(out, child_stdin_fd);
+    {
+        client->stdin = stream_from_fd(out, client->stdin_fd);
+        client->stdin_fd = -1;
+    }
 
-    raw_in = stream_from_fd(in, child_stderr_fd);
-    client->stderr = g_data_input_stream_new(raw_in);
-    g_object_unref(raw_in);
+    return TRUE;
+}
 
-    client->cancellable = g_cancellable_new();
+/* Error output is kept in a ring buffer, only the latest bytes matter */
+static void
+_j4status_i3bar_input_client_stderr_append(J4statusI3barInputClient *client, const gchar *data, gsize size)
+{
+    if ( size > STDERR_RING_SIZE )
+    {
+        data += size - STDERR_RING_SIZE;
+        size = STDERR_RING_SIZE;
+    }
+
+    gsize first = MIN(size, STDERR_RING_SIZE - client->stderr_ring.end);
+    memcpy(client->stderr_ring.buffer + client->stderr_ring.end, data, first);
+    memcpy(client->stderr_ring.buffer, data + first, size - first);
+
+    client->stderr_ring.end = ( client->stderr_ring.end + size ) % STDERR_RING_SIZE;
+    client->stderr_ring.length = MIN(client->stderr_ring.length + size, STDERR_RING_SIZE);
+}
+
+static gchar *
+_j4status_i3bar_input_client_stderr_get(J4statusI3barInputClient *client)
+{
+    gsize length = client->stderr_ring.length;
+    gsize start = ( client->stderr_ring.end + STDERR_RING_SIZE - length ) % STDERR_RING_SIZE;
+    gsize first = MIN(length, STDERR_RING_SIZE - start);
+
+    gchar *text, *line;
+    text = g_new(gchar, length + 1);
+    memcpy(text, client->stderr_ring.buffer + start, first);
+    memcpy(text + first, client->stderr_ring.buffer, length - first);
+    text[length] = '\0';
+
+    /* Drop the truncated first line */
+    if ( ( length == STDERR_RING_SIZE ) && ( ( line = memchr(text, '\n', length) ) != NULL ) )
+        memmove(text, line + 1, text + length - line);
+
+    return g_strchomp(text);
+}
+
+static void
+_j4status_i3bar_input_client_stderr_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
+    GError *error = NULL;
+
+    gssize size;
+    size = g_input_stream_read_finish(G_INPUT_STREAM(source_object), res, &error);
+    if ( (gpointer) source_object != client->stderr )
+    {
+        /* Leftover from a previous run */
+        g_clear_error(&error);
+        return;
+    }
+    if ( size < 0 )
+    {
+        g_warning("Couldn't read client '%s' error output: %s", client->name, error->message);
+        g_clear_error(&error);
+        return;
+    }
+    if ( size == 0 )
+        /* EOF */
+        return;
+
+    _j4status_i3bar_input_client_stderr_append(client, client->stderr_ring.chunk, size);
+    g_input_stream_read_async(client->stderr, client->stderr_ring.chunk, sizeof(client->stderr_ring.chunk), G_PRIORITY_LOW, client->cancellable, _j4status_i3bar_input_client_stderr_callback, client);
+}
+
+/* Resource usage, sampled from /proc while the client is running */
+static void
+_j4status_i3bar_input_client_update_usage(J4statusI3barInputClient *client)
+{
+    if ( client->pid == 0 )
+        return;
+
+    gchar path[64];
+    g_snprintf(path, sizeof(path), "/proc/%d/stat", (gint) client->pid);
+
+    gchar *contents;
+    if ( ! g_file_get_contents(path, &contents, NULL, NULL) )
+        return;
+
+    /* The command name may contain anything, fields start after its closing parenthesis */
+    const gchar *fields = strrchr(contents, ')');
+    guint64 utime, stime;
+    gint64 cutime, cstime, rss;
+    if ( ( fields != NULL ) && ( sscanf(fields + 1, " %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %*s %*s %*s %*s %*s %*s %" G_GINT64_FORMAT, &utime, &stime, &cutime, &cstime, &rss) == 5 ) )
+    {
+        /* Status scripts spend most of their time in their own children */
+        client->usage.run_cpu_time = ( utime + stime + MAX(cutime, 0) + MAX(cstime, 0) ) * 1000 / sysconf(_SC_CLK_TCK);
+        client->usage.rss = MAX(rss, 0) * ( sysconf(_SC_PAGESIZE) / 1024 );
+        client->usage.max_rss = MAX(client->usage.max_rss, client->usage.rss);
+    }
+
+    g_free(contents);
+}
+
+static gboolean
+_j4status_i3bar_input_usage_callback(gpointer user_data)
+{
+    J4statusPluginContext *context = user_data;
+
+    GList *client;
+    for ( client = context->clients ; client != NULL ; client = g_list_next(client) )
+        _j4status_i3bar_input_client_update_usage(client->data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+_j4status_i3bar_input_client_section_unavailable(G_GNUC_UNUSED gpointer key, gpointer value, G_GNUC_UNUSED gpointer user_data)
+{
+    j4status_section_set_state(value, J4STATUS_STATE_UNAVAILABLE);
+}
+
+/*
+ * Drops everything tied to the running process
+ * Sections are kept (marked unavailable) until the next run updates them
+ */
+static void
+_j4status_i3bar_input_client_reset(J4statusI3barInputClient *client)
+{
+    _j4status_i3bar_input_client_handshake_done(client);
+
+    if ( client->header_timeout > 0 )
+        g_source_remove(client->header_timeout);
+    client->header_timeout = 0;
+
+    if ( client->cancellable == NULL )
+        return;
+
+    g_cancellable_cancel(client->cancellable);
+    g_object_unref(client->cancellable);
+    client->cancellable = NULL;
+
+    /* We do not wait for a client to read the closing bracket */
+    _j4status_i3bar_input_client_events_clear(client);
+
+    if ( client->json_gen != NULL )
+        yajl_gen_free(client->json_gen);
+    client->json_gen = NULL;
+    if ( client->json_handle != NULL )
+        yajl_free(client->json_handle);
+    client->json_handle = NULL;
+
+    g_free(client->parse_context.error);
+    g_free(client->parse_context.name);
+    g_free(client->parse_context.instance);
+    g_free(client->parse_context.full_text);
+    g_free(client->parse_context.short_text);
+    memset(&client->parse_context, 0, sizeof(client->parse_context));
+
+    g_clear_object(&client->stderr);
+    g_clear_object(&client->stdout);
+    g_clear_object(&client->stdin);
+    if ( client->stdin_fd >= 0 )
+        close(client->stdin_fd);
+    client->stdin_fd = -1;
+
+    g_hash_table_foreach(client->sections, _j4status_i3bar_input_client_section_unavailable, NULL);
+}
+
+/* The child watch will restart it */
+static void
+_j4status_i3bar_input_client_kill(J4statusI3barInputClient *client)
+{
+    _j4status_i3bar_input_client_reset(client);
+
+#ifdef G_OS_UNIX
+    if ( client->pid != 0 )
+    {
+        kill(client->pid, SIGTERM);
+        /* In case we stopped it */
+        kill(client->pid, SIGCONT);
+    }
+#endif /* G_OS_UNIX */
+}
+
+static void
+_j4status_i3bar_input_client_header_callback(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
+    J4statusPluginContext *context = client->context;
+    GError *error = NULL;
+
+    gchar *header;
+    gsize length = 0;
+    header = g_data_input_stream_read_line_finish_utf8(G_DATA_INPUT_STREAM(source_object), res, &length, &error);
+    if ( (gpointer) source_object != client->stdout )
+    {
+        /* Leftover from a previous run */
+        g_free(header);
+        g_clear_error(&error);
+        return;
+    }
+
+    if ( client->header_timeout > 0 )
+        g_source_remove(client->header_timeout);
+    client->header_timeout = 0;
+
+    _j4status_i3bar_input_client_handshake_done(client);
+
+    if ( header == NULL )
+    {
+        if ( error == NULL )
+            g_warning("Client '%s' exited before sending its header", client->name);
+        else
+            g_warning("Couldn't read header from client '%s': %s", client->name, error->message);
+        g_clear_error(&error);
+        _j4status_i3bar_input_client_kill(client);
+        return;
+    }
+
+    gboolean r;
+    r = _j4status_i3bar_input_client_parse_header(client, header, length);
+    g_free(header);
+    if ( ! r )
+    {
+        _j4status_i3bar_input_client_kill(client);
+        return;
+    }
+
+    g_debug("Client '%s' sent its header after %" G_GINT64_FORMAT "ms", client->name, ( g_get_monotonic_time() - client->spawn_time ) / 1000);
 
     client->json_handle = yajl_alloc(&_j4status_i3bar_input_section_callbacks, NULL, client);
-    if ( header_context.click_events )
+    if ( client->stdin != NULL )
     {
         client->json_gen = yajl_gen_alloc(NULL);
         yajl_gen_array_open(client->json_gen);
-        _j4status_i3bar_input_client_write(client);
+        yajl_gen_clear(client->json_gen);
+        g_queue_push_tail(&client->events.queue, g_bytes_new_static("[\n", strlen("[\n")));
+        client->events.first = TRUE;
+        _j4status_i3bar_input_client_write_next(client);
     }
 
 #ifdef G_OS_UNIX
-    killpg(client->pid, client->stop_signal);
+    if ( ! context->started )
+        killpg(client->pid, client->stop_signal);
 #endif /* G_OS_UNIX */
 
+    /* Let chatty clients pile up several lines so we can skip old ones */
+    g_buffered_input_stream_set_buffer_size(G_BUFFERED_INPUT_STREAM(client->stdout), READ_BUFFER_SIZE);
     g_data_input_stream_read_line_async(client->stdout, G_PRIORITY_DEFAULT, client->cancellable, _j4status_i3bar_input_client_read_callback, client);
+}
 
-    client->sections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) j4status_section_free);
+static gboolean
+_j4status_i3bar_input_client_header_timeout(gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
 
-    return client;
+    client->header_timeout = 0;
+
+    g_warning("Client '%s' did not send its header in %u seconds", client->name, client->context->header_timeout);
+    _j4status_i3bar_input_client_kill(client);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean _j4status_i3bar_input_client_spawn(J4statusI3barInputClient *client);
+
+static gboolean
+_j4status_i3bar_input_client_restart(gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
+    J4statusPluginContext *context = client->context;
+
+    client->restart.timeout = 0;
+    ++client->restart.count;
+
+    if ( _j4status_i3bar_input_client_spawn(client) )
+        return G_SOURCE_REMOVE;
+
+    g_warning("Couldn't restart client '%s', retrying in %u seconds", client->name, client->restart.delay);
+    client->restart.timeout = g_timeout_add_seconds(client->restart.delay, _j4status_i3bar_input_client_restart, client);
+    client->restart.delay = MIN(client->restart.delay * 2, context->restart_max_delay);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_i3bar_input_client_child_watch(G_GNUC_UNUSED GPid pid, gint status, gpointer user_data)
+{
+    J4statusI3barInputClient *client = user_data;
+    J4statusPluginContext *context = client->context;
+    GError *error = NULL;
+
+    _j4status_i3bar_input_client_update_usage(client);
+    client->usage.cpu_time += client->usage.run_cpu_time;
+    client->usage.run_cpu_time = 0;
+    client->usage.rss = 0;
+
+    client->child_watch = 0;
+    g_spawn_close_pid(client->pid);
+    client->pid = 0;
+
+    _j4status_i3bar_input_client_reset(client);
+
+    gchar *stderr_text;
+    g_spawn_check_exit_status(status, &error);
+    stderr_text = _j4status_i3bar_input_client_stderr_get(client);
+    g_warning("Client '%s' exited: %s%s%s", client->name, ( error == NULL ) ? "normally" : error->message, ( *stderr_text == '\0' ) ? "" : "\nLast error output:\n", stderr_text);
+    g_free(stderr_text);
+    g_clear_error(&error);
 
-fail:
-    if ( client != NULL )
+    if ( context->restart_delay == 0 )
+        return;
+
+    /* A client that ran for a while gets a fresh start */
+    if ( ( client->restart.delay == 0 ) || ( ( g_get_monotonic_time() - client->spawn_time ) >= ( RESTART_STABLE_TIME * G_USEC_PER_SEC ) ) )
+        client->restart.delay = context->restart_delay;
+
+    g_message("Restarting client '%s' in %u seconds", client->name, client->restart.delay);
+    client->restart.timeout = g_timeout_add_seconds(client->restart.delay, _j4status_i3bar_input_client_restart, client);
+    client->restart.delay = MIN(client->restart.delay * 2, context->restart_max_delay);
+}
+
+static gboolean
+_j4status_i3bar_input_client_spawn(J4statusI3barInputClient *client)
+{
+    J4statusPluginContext *context = client->context;
+    GError *error = NULL;
+
+    gint child_stdout_fd, child_stderr_fd;
+    if ( ! g_spawn_async_with_pipes(NULL, client->argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &client->pid, &client->stdin_fd, &child_stdout_fd, &child_stderr_fd, &error) )
     {
-        if ( client->stdin != NULL )
-            g_object_unref(client->stdin);
-        if ( client->stdout != NULL )
-            g_object_unref(client->stdout);
-        if ( client->stderr != NULL )
-            g_object_unref(client->stderr);
-
-        if ( client->pid != 0 )
-            g_spawn_close_pid(client->pid);
-        g_free(client->name);
+        g_warning("Couldn't spawn '%s': %s", client->name, error->message);
+        g_clear_error(&error);
+        client->pid = 0;
+        return FALSE;
     }
-    g_free(client);
+    client->spawn_time = g_get_monotonic_time();
+    client->child_watch = g_child_watch_add(client->pid, _j4status_i3bar_input_client_child_watch, client);
 
-    g_strfreev(argv);
+    GInputStream *raw_in;
+    raw_in = stream_from_fd(in, child_stdout_fd);
+    client->stdout = g_data_input_stream_new(raw_in);
+    g_object_unref(raw_in);
 
-    g_clear_error(&error);
-    return NULL;
+    client->stderr = stream_from_fd(in, child_stderr_fd);
+
+    client->cancellable = g_cancellable_new();
+
+    if ( client->restart.count == 0 )
+    {
+        client->handshake = TRUE;
+        ++context->pending;
+    }
+
+    g_input_stream_read_async(client->stderr, client->stderr_ring.chunk, sizeof(client->stderr_ring.chunk), G_PRIORITY_LOW, client->cancellable, _j4status_i3bar_input_client_stderr_callback, client);
+    g_data_input_stream_read_line_async(client->stdout, G_PRIORITY_DEFAULT, client->cancellable, _j4status_i3bar_input_client_header_callback, client);
+    if ( context->header_timeout > 0 )
+        client->header_timeout = g_timeout_add_seconds(context->header_timeout, _j4status_i3bar_input_client_header_timeout, client);
+
+    return TRUE;
+}
+
+/*
+ * Clients are spawned all at once,
+ * and each one is set up when its header arrives
+ */
+static J4statusI3barInputClient *
+_j4status_i3bar_input_client_new(J4statusPluginContext *context, const gchar *client_command)
+{
+    GError *error = NULL;
+
+    gchar **argv = NULL;
+    if ( ! g_shell_parse_argv(client_command, NULL, &argv, &error) )
+    {
+        g_warning("Couldn't parse '%s': %s", client_command, error->message);
+        g_clear_error(&error);
+        return NULL;
+    }
+
+    J4statusI3barInputClient *client;
+    client = g_new0(J4statusI3barInputClient, 1);
+    client->context = context;
+    client->name = g_path_get_basename(argv[0]);
+    client->argv = argv;
+    client->stdin_fd = -1;
+    client->sections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) j4status_section_free);
+
+    if ( ! _j4status_i3bar_input_client_spawn(client) )
+    {
+        g_hash_table_unref(client->sections);
+        g_strfreev(client->argv);
+        g_free(client->name);
+        g_free(client);
+        return NULL;
+    }
+
+    return client;
 }
 
 static void
 _j4status_i3bar_input_client_free(gpointer data)
 {
     J4statusI3barInputClient *client = data;
+    J4statusPluginContext *context = client->context;
 
-    if ( client->stdin != NULL )
-    {
-        yajl_gen_array_close(client->json_gen);
-        _j4status_i3bar_input_client_write(client);
-    }
+    context->clients = g_list_delete_link(context->clients, client->link);
 
-    if ( client->json_gen != NULL )
-        yajl_gen_free(client->json_gen);
-    yajl_free(client->json_handle);
+    if ( client->skipped > 0 )
+        g_debug("Client '%s': skipped %" G_GUINT64_FORMAT " outdated frames", client->name, client->skipped);
 
-    g_object_unref(client->stderr);
-    g_object_unref(client->stdout);
-    if ( client->stdin != NULL )
-        g_object_unref(client->stdin);
+    _j4status_i3bar_input_client_reset(client);
 
-    g_spawn_close_pid(client->pid);
+    if ( client->restart.timeout > 0 )
+        g_source_remove(client->restart.timeout);
+    if ( client->child_watch > 0 )
+        g_source_remove(client->child_watch);
+    if ( client->pid != 0 )
+        g_spawn_close_pid(client->pid);
+
+    g_hash_table_unref(client->sections);
 
+    g_strfreev(client->argv);
+    g_free(client->name);
     g_free(client);
 }
 
@@ -776,6 +1392,10 @@ _j4status_i3bar_input_client_start(gpointer data, gpointer user_data)
 {
     J4statusI3barInputClient *client = data;
 
+    if ( client->json_handle == NULL )
+        /* Still waiting for its header, or not running */
+        return;
+
 #ifdef G_OS_UNIX
     killpg(client->pid, client->cont_signal);
 #endif /* G_OS_UNIX */
@@ -786,6 +1406,10 @@ _j4status_i3bar_input_client_stop(gpointer data, gpointer user_data)
 {
     J4statusI3barInputClient *client = data;
 
+    if ( client->json_handle == NULL )
+        /* Still waiting for its header, or not running */
+        return;
+
 #ifdef G_OS_UNIX
     killpg(client->pid, client->stop_signal);
 #endif /* G_OS_UNIX */
@@ -795,7 +1419,7 @@ static J4statusPluginContext *
 _j4status_i3bar_input_init(J4statusCoreInterface *core)
 {
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("i3bar");
+    key_file = j4status_config_get_group("i3bar");
     if ( key_file == NULL )
     {
         g_message("Missing configuration: No section, aborting");
@@ -807,33 +1431,62 @@ _j4status_i3bar_input_init(J4statusCoreInterface *core)
     if ( clients == NULL )
     {
         g_message("Missing configuration: Empty list of clients to monitor, aborting");
-        g_key_file_free(key_file);
         return NULL;
     }
-    g_key_file_free(key_file);
 
     J4statusPluginContext *context;
 
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
+    context->header_timeout = DEFAULT_HEADER_TIMEOUT;
+    context->restart_delay = DEFAULT_RESTART_DELAY;
+    context->restart_max_delay = DEFAULT_RESTART_MAX_DELAY;
+    context->init_time = g_get_monotonic_time();
+
+    GError *error = NULL;
+    gint64 header_timeout;
+    header_timeout = g_key_file_get_int64(key_file, "i3bar", "HeaderTimeout", &error);
+    if ( error == NULL )
+        context->header_timeout = CLAMP(header_timeout, 0, G_MAXUINT);
+    g_clear_error(&error);
+
+    gint64 restart_delay;
+    restart_delay = g_key_file_get_int64(key_file, "i3bar", "RestartDelay", &error);
+    if ( error == NULL )
+        context->restart_delay = CLAMP(restart_delay, 0, G_MAXUINT);
+    g_clear_error(&error);
+
+    gint64 restart_max_delay;
+    restart_max_delay = g_key_file_get_int64(key_file, "i3bar", "RestartMaxDelay", &error);
+    if ( error == NULL )
+        context->restart_max_delay = CLAMP(restart_max_delay, 0, G_MAXUINT);
+    g_clear_error(&error);
+    context->restart_max_delay = MAX(context->restart_max_delay, context->restart_delay);
 
     gchar **client_command;
     for ( client_command = clients ; *client_command != NULL ; ++client_command )
     {
         J4statusI3barInputClient *client;
         client = _j4status_i3bar_input_client_new(context, *client_command);
-        if ( client != NULL )
-            client->link = context->clients = g_list_prepend(context->clients, client);
+        if ( client == NULL )
+            continue;
+        client->index = client_command - clients;
+        client->link = context->clients = g_list_prepend(context->clients, client);
     }
     g_strfreev(clients);
 
+    context->usage_timeout = g_timeout_add_seconds(USAGE_INTERVAL, _j4status_i3bar_input_usage_callback, context);
+
     return context;
 }
 
 static void
 _j4status_i3bar_input_uninit(J4statusPluginContext *context)
 {
-    g_list_free_full(context->clients, _j4status_i3bar_input_client_free);
+    g_source_remove(context->usage_timeout);
+
+    while ( context->clients != NULL )
+        _j4status_i3bar_input_client_free(context->clients->data);
 
     g_free(context);
 }
@@ -841,15 +1494,49 @@ _j4status_i3bar_input_uninit(J4statusPluginContext *context)
 static void
 _j4status_i3bar_input_start(J4statusPluginContext *context)
 {
+    context->started = TRUE;
     g_list_foreach(context->clients, _j4status_i3bar_input_client_start, context);
 }
 
 static void
 _j4status_i3bar_input_stop(J4statusPluginContext *context)
 {
+    context->started = FALSE;
     g_list_foreach(context->clients, _j4status_i3bar_input_client_stop, context);
 }
 
+static void
+_j4status_i3bar_input_dump_stats(J4statusPluginContext *context, GKeyFile *key_file, const gchar *group)
+{
+    GList *client_;
+    for ( client_ = context->clients ; client_ != NULL ; client_ = g_list_next(client_) )
+    {
+        J4statusI3barInputClient *client = client_->data;
+        _j4status_i3bar_input_client_update_usage(client);
+
+        /* Several clients may share a binary, the index keeps groups apart */
+        gchar *client_group, *command, *stderr_text;
+        client_group = g_strdup_printf("%s client %u %s", group, client->index, client->name);
+        command = g_strjoinv(" ", client->argv);
+        stderr_text = _j4status_i3bar_input_client_stderr_get(client);
+
+        g_key_file_set_string(key_file, client_group, "Command", command);
+        g_key_file_set_int64(key_file, client_group, "Pid", client->pid);
+        g_key_file_set_uint64(key_file, client_group, "Restarts", client->restart.count);
+        g_key_file_set_uint64(key_file, client_group, "SkippedFrames", client->skipped);
+        g_key_file_set_uint64(key_file, client_group, "CoalescedEvents", client->events.coalesced);
+        g_key_file_set_uint64(key_file, client_group, "DroppedEvents", client->events.dropped);
+        g_key_file_set_uint64(key_file, client_group, "CpuTime", client->usage.cpu_time + client->usage.run_cpu_time);
+        g_key_file_set_uint64(key_file, client_group, "Rss", client->usage.rss);
+        g_key_file_set_uint64(key_file, client_group, "MaxRss", client->usage.max_rss);
+        g_key_file_set_string(key_file, client_group, "ErrorOutput", stderr_text);
+
+        g_free(stderr_text);
+        g_free(command);
+        g_free(client_group);
+    }
+}
+
 J4STATUS_EXPORT void
 j4status_input_plugin(J4statusInputPluginInterface *interface)
 {
@@ -858,4 +1545,6 @@ j4status_input_plugin(J4statusInputPluginInterface *interface)
 
     libj4status_input_plugin_interface_add_start_callback(interface, _j4status_i3bar_input_start);
     libj4status_input_plugin_interface_add_stop_callback(interface, _j4status_i3bar_input_stop);
+
+    libj4status_input_plugin_interface_add_dump_stats_callback(interface, _j4status_i3bar_input_dump_stats);
 }
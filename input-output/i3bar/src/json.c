@@ -0,0 +1,154 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif /* __AVX2__ */
+
+#include "json.h"
+
+/*
+ * What follows the backslash for characters yajl escapes,
+ * 'u' meaning \u00XX
+ */
+static const gchar _j4status_i3bar_json_escapes[256] = {
+    ['\0'] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u',
+    [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', [0x0b] = 'u',
+    ['\f'] = 'f', ['\r'] = 'r', [0x0e] = 'u', [0x0f] = 'u',
+    [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+    [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+    [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u',
+    [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+    ['"'] = '"', ['\\'] = '\\',
+};
+
+static const gchar _j4status_i3bar_json_hex[] = "0123456789ABCDEF";
+
+/* Returns the length of the leading run of characters not needing escaping */
+static gsize
+_j4status_i3bar_json_scan(const guchar *string, gsize length)
+{
+    gsize i = 0;
+
+#ifdef __AVX2__
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1f);
+    for ( ; i + 32 <= length ; i += 32 )
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) ( string + i ));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+            /* Saturated subtraction gives 0 for c <= 0x1f */
+            _mm256_cmpeq_epi8(_mm256_subs_epu8(chunk, control32), _mm256_setzero_si256()));
+        guint32 mask = _mm256_movemask_epi8(special);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+#endif /* __AVX2__ */
+
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for ( ; i + 16 <= length ; i += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) ( string + i ));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_subs_epu8(chunk, control), _mm_setzero_si128()));
+        guint32 mask = _mm_movemask_epi8(special);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+#endif /* __SSE2__ */
+
+    for ( ; i < length ; ++i )
+    {
+        if ( _j4status_i3bar_json_escapes[string[i]] != '\0' )
+            break;
+    }
+
+    return i;
+}
+
+void
+j4status_i3bar_json_append_escaped(GString *buffer, const gchar *string, gsize length)
+{
+    const guchar *s = (const guchar *) string;
+    gsize i = 0;
+
+    while ( i < length )
+    {
+        gsize clean;
+        clean = _j4status_i3bar_json_scan(s + i, length - i);
+        g_string_append_len(buffer, string + i, clean);
+        i += clean;
+        if ( i == length )
+            break;
+
+        gchar escape = _j4status_i3bar_json_escapes[s[i]];
+        if ( escape == 'u' )
+        {
+            gchar unicode[] = { '\\', 'u', '0', '0', _j4status_i3bar_json_hex[s[i] >> 4], _j4status_i3bar_json_hex[s[i] & 0xf] };
+            g_string_append_len(buffer, unicode, sizeof(unicode));
+        }
+        else
+        {
+            gchar simple[] = { '\\', escape };
+            g_string_append_len(buffer, simple, sizeof(simple));
+        }
+        ++i;
+    }
+}
+
+void
+j4status_i3bar_json_append_string(GString *buffer, const gchar *string)
+{
+    g_string_append_c(buffer, '"');
+    j4status_i3bar_json_append_escaped(buffer, string, strlen(string));
+    g_string_append_c(buffer, '"');
+}
+
+/* key must not need escaping */
+void
+j4status_i3bar_json_append_key(GString *buffer, gboolean *first, const gchar *key)
+{
+    if ( *first )
+        *first = FALSE;
+    else
+        g_string_append_c(buffer, ',');
+    g_string_append_c(buffer, '"');
+    g_string_append(buffer, key);
+    g_string_append_c(buffer, '"');
+    g_string_append_c(buffer, ':');
+}
@@ -0,0 +1,35 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __J4STATUS_I3BAR_JSON_H__
+#define __J4STATUS_I3BAR_JSON_H__
+
+/*
+ * Minimal JSON emitter for the hot path of the output plugin.
+ * Output is byte-identical to yajl_gen with default options.
+ */
+
+void j4status_i3bar_json_append_escaped(GString *buffer, const gchar *string, gsize length);
+void j4status_i3bar_json_append_string(GString *buffer, const gchar *string);
+void j4status_i3bar_json_append_key(GString *buffer, gboolean *first, const gchar *key);
+
+#endif /* __J4STATUS_I3BAR_JSON_H__ */
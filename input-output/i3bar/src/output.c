@@ -33,6 +33,8 @@
 
 #include "j4status-plugin-output.h"
 
+#include "json.h"
+
 #define yajl_strcmp(str1, len1, str2) ( ( strlen(str2) == len1 ) && ( g_ascii_strncasecmp((const gchar *) str1, str2, len1) == 0 ) )
 
 typedef enum {
@@ -70,8 +72,10 @@ typedef struct {
     guint array_key;
     gboolean in_event;
     J4statusI3barOutputClickEventsJsonKey key;
-    gchar *name;
-    gchar *instance;
+    GString *name;
+    GString *instance;
+    gboolean has_name;
+    gboolean has_instance;
     gchar *full_text;
     gint64 button;
 } J4statusI3barOutputClickEventsParseContext;
@@ -86,12 +90,19 @@ struct _J4statusPluginContext {
         gchar *good;
     } colours;
     gboolean align;
-    gsize last_len;
     gboolean no_click_events;
     yajl_handle json_handle;
     J4statusI3barOutputClickEventsParseContext parse_context;
+    GString *section_id;
+    GPtrArray *handles;
+    GArray *free_handles;
     gchar *header;
-    gchar *line;
+    struct {
+        GBytes *open;
+        GBytes *separator;
+        GBytes *close;
+    } fragments;
+    GPtrArray *line;
 };
 
 struct _J4statusOutputPluginStream {
@@ -101,6 +112,21 @@ struct _J4statusOutputPluginStream {
     GDataOutputStream *out;
 };
 
+/*
+ * Everything but the state, colours and values is fixed once the section
+ * is inserted, so we keep its JSON in a buffer and only rewrite the end
+ */
+typedef struct {
+    J4statusPluginContext *context;
+    J4statusSection *section;
+    guint handle;
+    GString *json;
+    gsize prefix_length;
+    gboolean prefix_empty;
+    GString *label;
+    GBytes *bytes;
+} J4statusI3barOutputSection;
+
 static int
 _j4status_i3bar_output_click_events_integer(void *user_data, long long value)
 {
@@ -166,10 +192,14 @@ _j4status_i3bar_output_click_events_string(void *user_data, const unsigned char
         /* For forward compatibility, we ignore unknown keys */
     break;
     case KEY_NAME:
-        context->parse_context.name = g_strndup((const gchar *) value, length);
+        g_string_truncate(context->parse_context.name, 0);
+        g_string_append_len(context->parse_context.name, (const gchar *) value, length);
+        context->parse_context.has_name = TRUE;
     break;
     case KEY_INSTANCE:
-        context->parse_context.instance = g_strndup((const gchar *) value, length);
+        g_string_truncate(context->parse_context.instance, 0);
+        g_string_append_len(context->parse_context.instance, (const gchar *) value, length);
+        context->parse_context.has_instance = TRUE;
     break;
     default:
         context->parse_context.error = g_strdup_printf("Wrong string key '%s'",
@@ -202,6 +232,38 @@ _j4status_i3bar_output_click_events_start_map(void *user_data)
     return 1;
 }
 
+/*
+ * Perfect hash of the known keys (case-insensitive),
+ * from their length and first and last characters
+ */
+#define KEY_HASH(first, last, length) ( ( (length) + (last) + ( (first) << 1 ) ) & 0xf )
+
+static const J4statusI3barOutputClickEventsJsonKey _j4status_i3bar_output_json_keys[16] = {
+    [KEY_HASH('n', 'e', 4)] = KEY_NAME,
+    [KEY_HASH('i', 'e', 8)] = KEY_INSTANCE,
+    [KEY_HASH('b', 'n', 6)] = KEY_BUTTON,
+    [KEY_HASH('x', 'x', 1)] = KEY_X,
+    [KEY_HASH('y', 'y', 1)] = KEY_Y,
+    [KEY_HASH('r', 'x', 10)] = KEY_RELATIVE_X,
+    [KEY_HASH('r', 'y', 10)] = KEY_RELATIVE_Y,
+    [KEY_HASH('w', 'h', 5)] = KEY_WIDTH,
+    [KEY_HASH('h', 't', 6)] = KEY_HEIGHT,
+};
+
+static J4statusI3barOutputClickEventsJsonKey
+_j4status_i3bar_output_click_events_key(const unsigned char *value, size_t length)
+{
+    if ( length == 0 )
+        return KEY_UNKNOWN;
+
+    J4statusI3barOutputClickEventsJsonKey key;
+    key = _j4status_i3bar_output_json_keys[KEY_HASH(g_ascii_tolower(value[0]), g_ascii_tolower(value[length - 1]), length)];
+    if ( ( key != KEY_NONE ) && yajl_strcmp(value, length, _j4status_i3bar_output_json_key_names[key]) )
+        return key;
+
+    return KEY_UNKNOWN;
+}
+
 static int
 _j4status_i3bar_output_click_events_map_key(void *user_data, const unsigned char *value, size_t length)
 {
@@ -214,21 +276,26 @@ _j4status_i3bar_output_click_events_map_key(void *user_data, const unsigned char
     }
 
     /* For forward compatibility, we ignore unknown keys */
-    context->parse_context.key = KEY_UNKNOWN;
-
-    gsize key;
-    for ( key = KEY_UNKNOWN + 1 ; key < G_N_ELEMENTS(_j4status_i3bar_output_json_key_names) ; ++key )
-    {
-        if ( yajl_strcmp(value, length, _j4status_i3bar_output_json_key_names[key]) )
-        {
-            context->parse_context.key = key;
-            break;
-        }
-    }
+    context->parse_context.key = _j4status_i3bar_output_click_events_key(value, length);
 
     return 1;
 }
 
+static J4statusI3barOutputSection *
+_j4status_i3bar_output_get_handle(J4statusPluginContext *context, const gchar *instance)
+{
+    if ( context->handles == NULL )
+        return NULL;
+
+    gchar *end;
+    guint64 handle;
+    handle = g_ascii_strtoull(instance, &end, 10);
+    if ( ( end == instance ) || ( *end != '\0' ) || ( handle >= context->handles->len ) )
+        return NULL;
+
+    return g_ptr_array_index(context->handles, handle);
+}
+
 static int
 _j4status_i3bar_output_click_events_end_map(void *user_data)
 {
@@ -237,37 +304,46 @@ _j4status_i3bar_output_click_events_end_map(void *user_data)
     if ( ! context->parse_context.in_event )
         return 0;
 
-    const gchar *name = context->parse_context.name;
-    const gchar *instance = context->parse_context.instance;
-    if ( name == NULL )
+    GString *name = context->parse_context.name;
+    GString *instance = context->parse_context.instance;
+    if ( ! context->parse_context.has_name )
     {
-        if ( instance != NULL )
-            context->parse_context.error = g_strdup_printf("Section instance but without name: %s", instance);
+        if ( context->parse_context.has_instance )
+            context->parse_context.error = g_strdup_printf("Section instance but without name: %s", instance->str);
         else
             context->parse_context.error = g_strdup_printf("No section name to match the section to send the action to");
         return 0;
     }
 
-    gchar *section_id, *event_id;
-    if ( instance != NULL )
-        section_id = g_strdup_printf("%s:%s", name, instance);
-    else
-        section_id = g_strdup(name);
-    event_id = g_strdup_printf("mouse:%jd", context->parse_context.button);
+    gchar event_id[sizeof("mouse:-9223372036854775808")];
+    g_snprintf(event_id, sizeof(event_id), "mouse:%" G_GINT64_FORMAT, context->parse_context.button);
 
-    j4status_core_trigger_action(context->core, section_id, event_id);
+    J4statusI3barOutputSection *section = NULL;
+    if ( context->parse_context.has_instance )
+        section = _j4status_i3bar_output_get_handle(context, instance->str);
 
-    g_free(event_id);
-    g_free(section_id);
+    if ( section != NULL )
+        j4status_section_trigger_action(section->section, event_id);
+    else
+    {
+        GString *section_id = context->section_id;
+        g_string_truncate(section_id, 0);
+        g_string_append_len(section_id, name->str, name->len);
+        if ( context->parse_context.has_instance )
+        {
+            g_string_append_c(section_id, ':');
+            g_string_append_len(section_id, instance->str, instance->len);
+        }
+
+        j4status_core_trigger_action(context->core, section_id->str, event_id);
+    }
 
     context->parse_context.in_event = FALSE;
 
     context->parse_context.key = KEY_NONE;
 
-    g_free(context->parse_context.name);
-    context->parse_context.name = NULL;
-    g_free(context->parse_context.instance);
-    context->parse_context.instance = NULL;
+    context->parse_context.has_name = FALSE;
+    context->parse_context.has_instance = FALSE;
 
     return 1;
 }
@@ -343,8 +419,8 @@ _j4status_i3bar_ouput_action(J4statusPluginContext *context, gchar *line)
 
     if ( json_state == yajl_status_ok )
         return;
-    g_free(context->parse_context.name);
-    g_free(context->parse_context.instance);
+    context->parse_context.has_name = FALSE;
+    context->parse_context.has_instance = FALSE;
 
     if ( json_state == yajl_status_error )
     {
@@ -443,7 +519,7 @@ _j4status_i3bar_output_init(J4statusCoreInterface *core)
     context->colours.good        = g_strdup("#00FF00");
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("i3bar");
+    key_file = j4status_config_get_group("i3bar");
     if ( key_file != NULL )
     {
         _j4status_i3bar_output_update_colour(&context->colours.no_state, key_file, "NoStateColour");
@@ -453,11 +529,28 @@ _j4status_i3bar_output_init(J4statusCoreInterface *core)
         _j4status_i3bar_output_update_colour(&context->colours.good, key_file, "GoodColour");
         context->align = g_key_file_get_boolean(key_file, "i3bar", "Align", NULL);
         context->no_click_events = g_key_file_get_boolean(key_file, "i3bar", "NoClickEvents", NULL);
-        g_key_file_free(key_file);
+        if ( ( ! context->no_click_events ) && g_key_file_get_boolean(key_file, "i3bar", "NumericInstances", NULL) )
+        {
+            context->handles = g_ptr_array_new();
+            context->free_handles = g_array_new(FALSE, FALSE, sizeof(guint));
+        }
     }
 
+    context->parse_context.name = g_string_new(NULL);
+    context->parse_context.instance = g_string_new(NULL);
+    context->section_id = g_string_new(NULL);
+
     context->json_handle = yajl_alloc(&_j4status_i3bar_output_click_events_callbacks, NULL, context);
 
+    context->fragments.open = g_bytes_new_static(",[", strlen(",["));
+    context->fragments.separator = g_bytes_new_static(",", strlen(","));
+    context->fragments.close = g_bytes_new_static("]\n", strlen("]\n"));
+
+    /* Clients may connect before the first frame, they get an empty line */
+    context->line = g_ptr_array_new_full(2, (GDestroyNotify) g_bytes_unref);
+    g_ptr_array_add(context->line, g_bytes_ref(context->fragments.open));
+    g_ptr_array_add(context->line, g_bytes_ref(context->fragments.close));
+
     return context;
 }
 
@@ -466,7 +559,20 @@ _j4status_i3bar_output_uninit(J4statusPluginContext *context)
 {
     yajl_free(context->json_handle);
 
-    g_free(context->line);
+    g_string_free(context->section_id, TRUE);
+    g_string_free(context->parse_context.instance, TRUE);
+    g_string_free(context->parse_context.name, TRUE);
+    if ( context->handles != NULL )
+    {
+        g_array_unref(context->free_handles);
+        g_ptr_array_unref(context->handles);
+    }
+
+    if ( context->line != NULL )
+        g_ptr_array_unref(context->line);
+    g_bytes_unref(context->fragments.close);
+    g_bytes_unref(context->fragments.separator);
+    g_bytes_unref(context->fragments.open);
     g_free(context->header);
 
     g_free(context);
@@ -513,95 +619,131 @@ _j4status_i3bar_output_send_header(J4statusPluginContext *context, J4statusOutpu
 }
 
 static void
-_j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusSection *section)
+_j4status_i3bar_output_section_free(gpointer data)
 {
-    const gchar *value;
-    gchar *labelled_value = NULL;
-    value = j4status_section_get_value(section);
+    J4statusI3barOutputSection *self = data;
+    J4statusPluginContext *context = self->context;
 
-    if ( value == NULL )
+    if ( context->handles != NULL )
     {
-        j4status_section_set_cache(section, NULL);
-        return;
+        g_ptr_array_index(context->handles, self->handle) = NULL;
+        g_array_append_val(context->free_handles, self->handle);
     }
 
-    yajl_gen json_gen;
+    if ( self->bytes != NULL )
+        g_bytes_unref(self->bytes);
+    if ( self->label != NULL )
+        g_string_free(self->label, TRUE);
+    g_string_free(self->json, TRUE);
 
-    json_gen = yajl_gen_alloc(NULL);
+    g_slice_free(J4statusI3barOutputSection, self);
+}
+
+static J4statusI3barOutputSection *
+_j4status_i3bar_output_section_new(J4statusPluginContext *context, J4statusSection *section)
+{
+    J4statusI3barOutputSection *self;
+    self = g_slice_new0(J4statusI3barOutputSection);
+    self->context = context;
+    self->section = section;
+    self->json = g_string_sized_new(128);
+
+    if ( context->handles != NULL )
+    {
+        if ( context->free_handles->len > 0 )
+        {
+            self->handle = g_array_index(context->free_handles, guint, context->free_handles->len - 1);
+            g_array_set_size(context->free_handles, context->free_handles->len - 1);
+            g_ptr_array_index(context->handles, self->handle) = self;
+        }
+        else
+        {
+            self->handle = context->handles->len;
+            g_ptr_array_add(context->handles, self);
+        }
+    }
+
+    GString *json = self->json;
+    gboolean first;
 
     const gchar *label;
     label = j4status_section_get_label(section);
     const gchar *label_colour;
     label_colour = j4status_colour_to_hex(j4status_section_get_label_colour(section));
 
-
     if ( ( label != NULL ) && ( label_colour != NULL ) )
     {
-        gchar *label_with_sep;
-        label_with_sep = g_strdup_printf("%s: ", label);
-
-        /*
-         * We create a fake section with just the label
-         * so we open an array to have yajl generate a
-         * comma between the two sections
-         */
-        yajl_gen_array_open(json_gen);
-        yajl_gen_clear(json_gen); /* We need the comma alone */
-        yajl_gen_map_open(json_gen);
-
-        yajl_gen_string(json_gen, (const unsigned char *)"color", strlen("color"));
-        yajl_gen_string(json_gen, (const unsigned char *)label_colour, strlen("#000000"));
-
-        yajl_gen_string(json_gen, (const unsigned char *)"full_text", strlen("full_text"));
-        yajl_gen_string(json_gen, (const unsigned char *)label_with_sep, strlen(label_with_sep));
-
-        yajl_gen_string(json_gen, (const unsigned char *)"separator", strlen("separator"));
-        yajl_gen_bool(json_gen, FALSE);
-        yajl_gen_string(json_gen, (const unsigned char *)"separator_block_width", strlen("separator_block_width"));
-        yajl_gen_integer(json_gen, 0);
-
-        yajl_gen_map_close(json_gen);
-
-        g_free(label_with_sep);
+        /* A fake section with just the label */
+        g_string_append_c(json, '{');
+        first = TRUE;
+
+        j4status_i3bar_json_append_key(json, &first, "color");
+        g_string_append_c(json, '"');
+        g_string_append_len(json, label_colour, strlen("#000000"));
+        g_string_append_c(json, '"');
+
+        j4status_i3bar_json_append_key(json, &first, "full_text");
+        g_string_append_c(json, '"');
+        j4status_i3bar_json_append_escaped(json, label, strlen(label));
+        g_string_append(json, ": \"");
+
+        j4status_i3bar_json_append_key(json, &first, "separator");
+        g_string_append(json, "false");
+        j4status_i3bar_json_append_key(json, &first, "separator_block_width");
+        g_string_append_c(json, '0');
+
+        g_string_append_c(json, '}');
+        g_string_append_c(json, ',');
     }
     else if ( label != NULL )
-        value = labelled_value = g_strdup_printf("%s: %s", label, value);
+    {
+        self->label = g_string_new(NULL);
+        j4status_i3bar_json_append_escaped(self->label, label, strlen(label));
+        g_string_append(self->label, ": ");
+    }
 
-    yajl_gen_map_open(json_gen);
+    g_string_append_c(json, '{');
+    first = TRUE;
 
     const gchar *name;
     name = j4status_section_get_name(section);
     if ( name != NULL )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"name", strlen("name"));
-        yajl_gen_string(json_gen, (const unsigned char *)name, strlen(name));
+        j4status_i3bar_json_append_key(json, &first, "name");
+        j4status_i3bar_json_append_string(json, name);
     }
 
     const gchar *instance;
     instance = j4status_section_get_instance(section);
-    if ( instance != NULL )
+    if ( context->handles != NULL )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"instance", strlen("instance"));
-        yajl_gen_string(json_gen, (const unsigned char *)instance, strlen(instance));
+        /* i3bar gives it back on click, we know the section right away */
+        j4status_i3bar_json_append_key(json, &first, "instance");
+        g_string_append_printf(json, "\"%u\"", self->handle);
+    }
+    else if ( instance != NULL )
+    {
+        j4status_i3bar_json_append_key(json, &first, "instance");
+        j4status_i3bar_json_append_string(json, instance);
     }
 
     gint64 max_width;
     max_width = j4status_section_get_max_width(section);
     if ( context->align && ( max_width != 0 ) )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"min_width", strlen("min_width"));
+        j4status_i3bar_json_append_key(json, &first, "min_width");
         if ( max_width < 0 )
         {
             gsize l = - max_width + 1;
             if ( ( label != NULL ) && ( label_colour == NULL ) )
-                l += strlen(label);
-            gchar max_value[l];
-            memset(max_value, 'm', l);
-            max_value[l] ='\0';
-            yajl_gen_string(json_gen, (const unsigned char *)max_value, l);
+                l += j4status_section_get_label_width(section);
+            g_string_append_c(json, '"');
+            while ( l-- > 0 )
+                g_string_append_c(json, 'm');
+            g_string_append_c(json, '"');
         }
         else
-            yajl_gen_integer(json_gen, max_width);
+            g_string_append_printf(json, "%" G_GINT64_FORMAT, max_width);
 
         const gchar *align = NULL;
         switch ( j4status_section_get_align(section) )
@@ -617,11 +759,45 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
         }
         if ( align != NULL )
         {
-            yajl_gen_string(json_gen, (const unsigned char *)"align", strlen("align"));
-            yajl_gen_string(json_gen, (const unsigned char *)align, strlen(align));
+            j4status_i3bar_json_append_key(json, &first, "align");
+            j4status_i3bar_json_append_string(json, align);
         }
     }
 
+    self->prefix_length = json->len;
+    self->prefix_empty = first;
+
+    j4status_section_set_output_user_data(section, self, _j4status_i3bar_output_section_free);
+
+    return self;
+}
+
+static void
+_j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusSection *section)
+{
+    J4statusI3barOutputSection *self;
+    self = j4status_section_get_output_user_data(section);
+
+    const gchar *value;
+    value = j4status_section_get_value(section);
+
+    if ( value == NULL )
+    {
+        if ( ( self != NULL ) && ( self->bytes != NULL ) )
+        {
+            g_bytes_unref(self->bytes);
+            self->bytes = NULL;
+        }
+        return;
+    }
+
+    if ( self == NULL )
+        self = _j4status_i3bar_output_section_new(context, section);
+
+    GString *json = self->json;
+    gboolean first = self->prefix_empty;
+    g_string_truncate(json, self->prefix_length);
+
     J4statusState state = j4status_section_get_state(section);
     const gchar *colour = NULL;
     const gchar *background_colour = NULL;
@@ -647,8 +823,8 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
     }
     if ( state & J4STATUS_STATE_URGENT )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"urgent", strlen("urgent"));
-        yajl_gen_bool(json_gen, TRUE);
+        j4status_i3bar_json_append_key(json, &first, "urgent");
+        g_string_append(json, "true");
     }
 
     const gchar *forced_colour;
@@ -658,8 +834,10 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
 
     if ( colour != NULL )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"color", strlen("color"));
-        yajl_gen_string(json_gen, (const unsigned char *)colour, strlen("#000000"));
+        j4status_i3bar_json_append_key(json, &first, "color");
+        g_string_append_c(json, '"');
+        g_string_append_len(json, colour, strlen("#000000"));
+        g_string_append_c(json, '"');
     }
 
     forced_colour = j4status_colour_to_hex(j4status_section_get_background_colour(section));
@@ -668,71 +846,110 @@ _j4status_i3bar_output_process_section(J4statusPluginContext *context, J4statusS
 
     if ( background_colour != NULL )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"background", strlen("background"));
-        yajl_gen_string(json_gen, (const unsigned char *)background_colour, strlen("#000000"));
+        j4status_i3bar_json_append_key(json, &first, "background");
+        g_string_append_c(json, '"');
+        g_string_append_len(json, background_colour, strlen("#000000"));
+        g_string_append_c(json, '"');
     }
 
     const gchar *short_value;
     short_value = j4status_section_get_short_value(section);
     if ( short_value != NULL )
     {
-        yajl_gen_string(json_gen, (const unsigned char *)"short_text", strlen("short_text"));
-        yajl_gen_string(json_gen, (const unsigned char *)short_value, strlen(short_value));
+        j4status_i3bar_json_append_key(json, &first, "short_text");
+        j4status_i3bar_json_append_string(json, short_value);
     }
 
-    yajl_gen_string(json_gen, (const unsigned char *)"full_text", strlen("full_text"));
-    yajl_gen_string(json_gen, (const unsigned char *)value, strlen(value));
-    g_free(labelled_value);
-
-    yajl_gen_map_close(json_gen);
+    j4status_i3bar_json_append_key(json, &first, "full_text");
+    g_string_append_c(json, '"');
+    if ( self->label != NULL )
+        g_string_append_len(json, self->label->str, self->label->len);
+    j4status_i3bar_json_append_escaped(json, value, strlen(value));
+    g_string_append_c(json, '"');
 
-    const unsigned char *buffer;
-    size_t length;
-    yajl_gen_get_buf(json_gen, &buffer, &length);
+    g_string_append_c(json, '}');
 
-    j4status_section_set_cache(section, g_strdup((const gchar *)buffer));
-
-    yajl_gen_free(json_gen);
+    /* Previous lines may still be in flight, so we need a new fragment */
+    if ( self->bytes != NULL )
+        g_bytes_unref(self->bytes);
+    self->bytes = g_bytes_new(json->str, json->len);
 }
 
+/*
+ * The line is a list of fragments shared with the sections,
+ * so unchanged sections are never copied
+ */
 static void
-_j4status_i3bar_output_generate_line(J4statusPluginContext *context, GList *sections)
+_j4status_i3bar_output_join_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
 {
-    GString *line = g_string_sized_new(context->last_len);
-    g_string_append_c(g_string_append_c(line, ','), '[');
+    GPtrArray *line;
+    line = g_ptr_array_new_full(2 * length + 2, (GDestroyNotify) g_bytes_unref);
+    g_ptr_array_add(line, g_bytes_ref(context->fragments.open));
     gboolean first = TRUE;
-    GList *section_;
-    J4statusSection *section;
-    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
     {
-
-        section = section_->data;
-        if ( j4status_section_is_dirty(section) )
-            _j4status_i3bar_output_process_section(context, section);
-
-        const gchar *cache;
-        cache = j4status_section_get_cache(section);
-        if ( cache == NULL )
+        J4statusI3barOutputSection *section;
+        section = j4status_section_get_output_user_data(sections[i]);
+        if ( ( section == NULL ) || ( section->bytes == NULL ) )
             continue;
 
         if ( first )
             first = FALSE;
         else
-            g_string_append_c(line, ',');
-        g_string_append(line, cache);
+            g_ptr_array_add(line, g_bytes_ref(context->fragments.separator));
+        g_ptr_array_add(line, g_bytes_ref(section->bytes));
     }
+    g_ptr_array_add(line, g_bytes_ref(context->fragments.close));
 
-    g_string_append_c(g_string_append_c(line, ']'), '\n');
-    context->last_len = line->len;
+    if ( context->line != NULL )
+        g_ptr_array_unref(context->line);
+    context->line = line;
+}
 
-    g_free(context->line);
-    context->line = g_string_free(line, FALSE);
+static void
+_j4status_i3bar_output_generate_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( j4status_section_is_dirty(sections[i]) )
+            _j4status_i3bar_output_process_section(context, sections[i]);
+    }
+    _j4status_i3bar_output_join_line(context, sections, length);
+}
+
+static void
+_j4status_i3bar_output_generate_line_incremental(J4statusPluginContext *context, J4statusSection * const *sections, gsize length, J4statusSection * const *dirty, gsize dirty_length)
+{
+    gsize i;
+    for ( i = 0 ; i < dirty_length ; ++i )
+        _j4status_i3bar_output_process_section(context, dirty[i]);
+    _j4status_i3bar_output_join_line(context, sections, length);
 }
 
 static gboolean
 _j4status_i3bar_output_send_line(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
 {
-    return g_data_output_stream_put_string(stream->out, context->line, NULL, error);
+    guint i;
+    for ( i = 0 ; i < context->line->len ; ++i )
+    {
+        gsize size;
+        gconstpointer data;
+        data = g_bytes_get_data(g_ptr_array_index(context->line, i), &size);
+        if ( ! g_output_stream_write_all(G_OUTPUT_STREAM(stream->out), data, size, NULL, NULL, error) )
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+_j4status_i3bar_output_get_line(J4statusPluginContext *context, GPtrArray *chunks)
+{
+    guint i;
+    for ( i = 0 ; i < context->line->len ; ++i )
+        g_ptr_array_add(chunks, g_bytes_ref(g_ptr_array_index(context->line, i)));
+    return TRUE;
 }
 
 J4STATUS_EXPORT void
@@ -745,6 +962,8 @@ j4status_output_plugin(J4statusOutputPluginInterface *interface)
     libj4status_output_plugin_interface_add_stream_free_callback(interface, _j4status_i3bar_output_stream_free);
 
     libj4status_output_plugin_interface_add_send_header_callback(interface, _j4status_i3bar_output_send_header);
-    libj4status_output_plugin_interface_add_generate_line_callback(interface, _j4status_i3bar_output_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_array_callback(interface, _j4status_i3bar_output_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_incremental_callback(interface, _j4status_i3bar_output_generate_line_incremental);
     libj4status_output_plugin_interface_add_send_line_callback(interface, _j4status_i3bar_output_send_line);
+    libj4status_output_plugin_interface_add_get_line_callback(interface, _j4status_i3bar_output_get_line);
 }
@@ -0,0 +1,154 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Feeds a recorded i3bar click stream through the output parser,
+ * for 10 and 1000 sections, with named and numeric instances
+ * The core lookup is a hash table, like the real one
+ */
+
+#include "../src/output.c"
+
+#include "test-core.h"
+
+#define EVENTS 100000
+
+struct _J4statusCoreContext {
+    GHashTable *sections;
+};
+
+/* Events as i3bar sends them, the instance is filled in for each one */
+static const gchar * const _bench_events[] = {
+    "{\"name\":\"bench\",\"instance\":\"%u\",\"button\":1,\"modifiers\":[],\"x\":1604,\"y\":9,\"relative_x\":41,\"relative_y\":9,\"output_x\":1604,\"output_y\":9,\"width\":86,\"height\":18,\"scale\":1}",
+    "{\"name\":\"bench\",\"instance\":\"%u\",\"button\":3,\"modifiers\":[\"Mod4\"],\"x\":1212,\"y\":11,\"relative_x\":7,\"relative_y\":11,\"output_x\":1212,\"output_y\":11,\"width\":54,\"height\":18,\"scale\":1}",
+    "{\"name\":\"bench\",\"instance\":\"%u\",\"button\":4,\"modifiers\":[],\"x\":1730,\"y\":4,\"relative_x\":63,\"relative_y\":4,\"output_x\":1730,\"output_y\":4,\"width\":112,\"height\":18,\"scale\":1}",
+    "{\"name\":\"bench\",\"instance\":\"%u\",\"button\":5,\"modifiers\":[],\"x\":1731,\"y\":5,\"relative_x\":64,\"relative_y\":5,\"output_x\":1731,\"output_y\":5,\"width\":112,\"height\":18,\"scale\":1}",
+};
+
+static guint64 _bench_actions;
+
+static void
+_bench_trigger_action(J4statusCoreContext *context, const gchar *section_id, const gchar *event_id)
+{
+    J4statusSection *section;
+    section = g_hash_table_lookup(context->sections, section_id);
+    if ( section != NULL )
+        j4status_section_trigger_action(section, event_id);
+}
+
+static void
+_bench_action_callback(G_GNUC_UNUSED J4statusSection *section, G_GNUC_UNUSED const gchar *event_id, G_GNUC_UNUSED gpointer user_data)
+{
+    ++_bench_actions;
+}
+
+static gboolean
+_bench_run(gchar **lines, guint length, gboolean numeric)
+{
+    J4statusCoreContext core_context;
+    J4statusCoreInterface core;
+    J4statusPluginContext *context;
+
+    j4status_test_core_init(&core);
+    core.context = &core_context;
+    core.trigger_action = _bench_trigger_action;
+    core_context.sections = g_hash_table_new(g_str_hash, g_str_equal);
+
+    context = _j4status_i3bar_output_init(&core);
+    if ( numeric && ( context->handles == NULL ) )
+    {
+        context->handles = g_ptr_array_new();
+        context->free_handles = g_array_new(FALSE, FALSE, sizeof(guint));
+    }
+
+    J4statusSection **sections = g_new(J4statusSection *, length);
+    guint i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        gchar instance[16];
+        g_snprintf(instance, sizeof(instance), "%u", i);
+
+        sections[i] = j4status_section_new(&core);
+        j4status_section_set_name(sections[i], "bench");
+        j4status_section_set_instance(sections[i], instance);
+        j4status_section_set_action_callback(sections[i], _bench_action_callback, NULL);
+        j4status_section_insert(sections[i]);
+        j4status_section_set_value(sections[i], g_strdup("bench"));
+        _j4status_i3bar_output_process_section(context, sections[i]);
+        g_hash_table_insert(core_context.sections, sections[i]->id, sections[i]);
+    }
+
+    _bench_actions = 0;
+    gint64 start = g_get_monotonic_time();
+    for ( i = 0 ; lines[i] != NULL ; ++i )
+        _j4status_i3bar_ouput_action(context, lines[i]);
+    gint64 duration = g_get_monotonic_time() - start;
+
+    g_print("%u sections, %s instances: %.1f ns per event\n", length, numeric ? "numeric" : "named", (gdouble) duration * 1000. / EVENTS);
+
+    for ( i = 0 ; i < length ; ++i )
+        j4status_section_free(sections[i]);
+    g_free(sections);
+    g_hash_table_unref(core_context.sections);
+    _j4status_i3bar_output_uninit(context);
+
+    if ( _bench_actions != EVENTS )
+    {
+        g_printerr("Only %" G_GUINT64_FORMAT " of %u events reached their section\n", _bench_actions, EVENTS);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+int
+main(G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
+{
+    static const guint lengths[] = { 10, 1000 };
+    gboolean r = TRUE;
+
+    gsize l;
+    for ( l = 0 ; l < G_N_ELEMENTS(lengths) ; ++l )
+    {
+        /* i3bar opens an endless array, then sends one event per line */
+        GRand *rand = g_rand_new_with_seed(13);
+        gchar **lines = g_new(gchar *, EVENTS + 2);
+        lines[0] = g_strdup("[");
+        guint i;
+        for ( i = 0 ; i < EVENTS ; ++i )
+        {
+            gchar *event;
+            event = g_strdup_printf(_bench_events[g_rand_int_range(rand, 0, G_N_ELEMENTS(_bench_events))], g_rand_int_range(rand, 0, lengths[l]));
+            lines[i + 1] = ( i == 0 ) ? event : g_strconcat(",", event, NULL);
+            if ( i > 0 )
+                g_free(event);
+        }
+        lines[EVENTS + 1] = NULL;
+        g_rand_free(rand);
+
+        r = _bench_run(lines, lengths[l], FALSE) && r;
+        r = _bench_run(lines, lengths[l], TRUE) && r;
+
+        g_strfreev(lines);
+    }
+
+    return r ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Renders N sections (32 by default) per frame, each with a new value
+ * Half of them have their own colour, all have a label and are aligned
+ */
+
+#include "../src/output.c"
+
+#include "test-core.h"
+
+#define FRAMES 10000
+
+int
+main(int argc, char *argv[])
+{
+    J4statusCoreInterface core;
+    J4statusPluginContext *context;
+    guint length = ( argc > 1 ) ? g_ascii_strtoull(argv[1], NULL, 10) : 32;
+
+    j4status_test_core_init(&core);
+
+    context = _j4status_i3bar_output_init(&core);
+    context->align = TRUE;
+
+    J4statusSection **sections = g_new(J4statusSection *, length);
+    guint i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        gchar instance[16];
+        g_snprintf(instance, sizeof(instance), "%u", i);
+
+        sections[i] = j4status_section_new(&core);
+        j4status_section_set_name(sections[i], "bench");
+        j4status_section_set_instance(sections[i], instance);
+        j4status_section_set_label(sections[i], "Bench");
+        j4status_section_set_max_width(sections[i], -12);
+        j4status_section_set_align(sections[i], J4STATUS_ALIGN_RIGHT);
+        j4status_section_insert(sections[i]);
+
+        if ( i % 2 )
+        {
+            J4statusColour colour = { .set = TRUE, .red = 0x12, .green = 0x34, .blue = 0x56, .alpha = 0xff };
+            j4status_section_set_colour(sections[i], colour);
+        }
+    }
+
+    gint64 duration = 0;
+    guint frame;
+    for ( frame = 0 ; frame < FRAMES ; ++frame )
+    {
+        for ( i = 0 ; i < length ; ++i )
+        {
+            j4status_section_set_state(sections[i], ( frame + i ) % _J4STATUS_STATE_SIZE);
+            j4status_section_set_value(sections[i], g_strdup_printf("%u \"%%\"", ( frame + i ) % 1000));
+        }
+
+        gint64 start = g_get_monotonic_time();
+        for ( i = 0 ; i < length ; ++i )
+            _j4status_i3bar_output_process_section(context, sections[i]);
+        duration += g_get_monotonic_time() - start;
+    }
+
+    g_print("%u sections, %u frames: %.1f ns per section\n", length, FRAMES, (gdouble) duration * 1000. / FRAMES / length);
+
+    for ( i = 0 ; i < length ; ++i )
+        j4status_section_free(sections[i]);
+    g_free(sections);
+    _j4status_i3bar_output_uninit(context);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Our JSON writer must give the very same bytes as yajl_gen
+ * with default options, which it replaces in the output plugin
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <yajl/yajl_gen.h>
+
+#include "../src/json.h"
+
+#define RANDOM_STRINGS 10000
+#define RANDOM_MAX_LENGTH 200
+
+static const gchar *_test_strings[] = {
+    "",
+    "plain",
+    "quote \" and backslash \\",
+    "\b\f\n\r\t",
+    "\x01\x02\x1e\x1f\x7f",
+    "solidus / stays",
+    "UTF-8: é 😀 ✓",
+    /* Long enough for the vector paths, special character in each lane */
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\"",
+    "0123456789abcdef\n0123456789abcdef0123456789abcdef0123456789abcdef",
+    "0123456789abcdef0123456789abcdef\\0123456789abcdef",
+};
+
+static gboolean
+_test_compare(const gchar *string, gsize length)
+{
+    yajl_gen gen;
+    const unsigned char *expected;
+    size_t expected_length;
+
+    gen = yajl_gen_alloc(NULL);
+    yajl_gen_map_open(gen);
+    yajl_gen_string(gen, (const unsigned char *) "full_text", strlen("full_text"));
+    yajl_gen_string(gen, (const unsigned char *) string, length);
+    yajl_gen_string(gen, (const unsigned char *) "name", strlen("name"));
+    yajl_gen_string(gen, (const unsigned char *) "j4status", strlen("j4status"));
+    yajl_gen_map_close(gen);
+    yajl_gen_get_buf(gen, &expected, &expected_length);
+
+    GString *json = g_string_new("{");
+    gboolean first = TRUE;
+    j4status_i3bar_json_append_key(json, &first, "full_text");
+    g_string_append_c(json, '"');
+    j4status_i3bar_json_append_escaped(json, string, length);
+    g_string_append_c(json, '"');
+    j4status_i3bar_json_append_key(json, &first, "name");
+    j4status_i3bar_json_append_string(json, "j4status");
+    g_string_append_c(json, '}');
+
+    gboolean r = ( json->len == expected_length ) && ( memcmp(json->str, expected, expected_length) == 0 );
+    if ( ! r )
+        g_printerr("Mismatch:\n  yajl: %.*s\n  ours: %s\n", (int) expected_length, expected, json->str);
+
+    g_string_free(json, TRUE);
+    yajl_gen_free(gen);
+
+    return r;
+}
+
+int
+main(G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
+{
+    gboolean r = TRUE;
+
+    gsize i;
+    for ( i = 0 ; i < G_N_ELEMENTS(_test_strings) ; ++i )
+        r = _test_compare(_test_strings[i], strlen(_test_strings[i])) && r;
+
+    /* Any byte but NUL, biased towards the ones we escape */
+    GRand *rand = g_rand_new_with_seed(4);
+    gchar string[RANDOM_MAX_LENGTH];
+    for ( i = 0 ; i < RANDOM_STRINGS ; ++i )
+    {
+        gsize length = g_rand_int_range(rand, 0, RANDOM_MAX_LENGTH);
+        gsize j;
+        for ( j = 0 ; j < length ; ++j )
+        {
+            if ( g_rand_int_range(rand, 0, 8) == 0 )
+                string[j] = "\"\\\x01\b\f\n\r\t\x1f"[g_rand_int_range(rand, 0, 9)];
+            else
+                string[j] = g_rand_int_range(rand, 1, 256);
+        }
+        r = _test_compare(string, length) && r;
+    }
+    g_rand_free(rand);
+
+    return r ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * i3bar "min_width" strings only pad a block, they must never cut its text
+ * A negative MaxWidth= from the configuration still does
+ */
+
+#include "../src/input.c"
+
+#include <glib/gstdio.h>
+
+#include "test-core.h"
+
+static const gchar _test_config[] =
+    "[Override test-configured]\n"
+    "MaxWidth=-4\n";
+
+static const gchar _test_line[] =
+    "["
+    "{\"name\":\"test-percent\",\"full_text\":\"Battery 95%\",\"min_width\":\"100%\"},"
+    "{\"name\":\"test-unit\",\"full_text\":\"deactivating\",\"min_width\":\"listening\"},"
+    "{\"name\":\"test-configured\",\"full_text\":\"Battery 95%\"}"
+    "]";
+
+static gboolean
+_test_value(J4statusI3barInputClient *client, const gchar *id, const gchar *expected)
+{
+    J4statusSection *section;
+    const gchar *value = NULL;
+
+    section = g_hash_table_lookup(client->sections, id);
+    if ( section != NULL )
+        value = j4status_section_get_value(section);
+
+    if ( g_strcmp0(value, expected) == 0 )
+        return TRUE;
+
+    g_printerr("Section %s: expected '%s', got '%s'\n", id, expected, value);
+    return FALSE;
+}
+
+int
+main(G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
+{
+    GError *error = NULL;
+    gchar *config_file;
+    gint fd;
+
+    fd = g_file_open_tmp("j4status-test-XXXXXX", &config_file, &error);
+    if ( fd < 0 )
+    {
+        g_printerr("Couldn't create the configuration file: %s\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    close(fd);
+    if ( ! g_file_set_contents(config_file, _test_config, -1, &error) )
+    {
+        g_printerr("Couldn't write the configuration file: %s\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+
+    /* Only our configuration, the user's one could override our sections */
+    g_setenv("XDG_CONFIG_HOME", "/nonexistent", TRUE);
+    g_setenv("J4STATUS_CONFIG_FILE", config_file, TRUE);
+
+    J4statusCoreInterface core;
+    J4statusPluginContext context = { .core = &core };
+    J4statusI3barInputClient client = {
+        .context = &context,
+        .name = (gchar *) "test",
+        .stdin_fd = -1,
+    };
+
+    j4status_test_core_init(&core);
+    client.sections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) j4status_section_free);
+    client.parse_context.align = J4STATUS_ALIGN_CENTER;
+    client.json_handle = yajl_alloc(&_j4status_i3bar_input_section_callbacks, NULL, &client);
+
+    gboolean r = _j4status_i3bar_input_client_parse(&client, _test_line, strlen(_test_line));
+    if ( r )
+        r = ( yajl_complete_parse(client.json_handle) == yajl_status_ok );
+    if ( ! r )
+        g_printerr("Couldn't parse the test line\n");
+
+    r = _test_value(&client, "test-percent", "Battery 95%") && r;
+    r = _test_value(&client, "test-unit", "deactivating") && r;
+    r = _test_value(&client, "test-configured", "Bat…") && r;
+
+    yajl_free(client.json_handle);
+    g_hash_table_unref(client.sections);
+    g_unlink(config_file);
+    g_free(config_file);
+
+    return r ? 0 : 1;
+}
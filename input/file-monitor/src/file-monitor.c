@@ -81,7 +81,7 @@ _j4status_file_monitor_init(J4statusCoreInterface *core)
         g_warning("Couldn't create the directory to monitor '%s': %s", dir, g_strerror(errno));
         goto fail;
     }
-    key_file = j4status_config_get_key_file("FileMonitor");
+    key_file = j4status_config_get_group("FileMonitor");
     if ( key_file == NULL )
     {
         g_message("Missing configuration: No section, aborting");
@@ -96,8 +96,6 @@ _j4status_file_monitor_init(J4statusCoreInterface *core)
         goto fail;
     }
 
-    g_key_file_free(key_file);
-
     J4statusPluginContext *context;
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
@@ -157,8 +155,6 @@ _j4status_file_monitor_init(J4statusCoreInterface *core)
     return context;
 
 fail:
-    if ( key_file != NULL )
-        g_key_file_free(key_file);
     g_free(dir);
     return NULL;
 }
@@ -455,11 +455,10 @@ _j4status_mpd_section_new(J4statusPluginContext *context, const gchar *host, gui
     gchar *format = NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file(group_name);
+    key_file = j4status_config_get_group(group_name);
     if ( key_file != NULL )
     {
         format = g_key_file_get_string(key_file, group_name, "Format", NULL);
-        g_key_file_free(key_file);
     }
 
     section->format = j4status_format_string_parse(format, _j4status_mpd_format_tokens, G_N_ELEMENTS(_j4status_mpd_format_tokens), J4STATUS_MPD_DEFAULT_FORMAT, &section->used_tokens);
@@ -488,7 +487,7 @@ _j4status_mpd_init(J4statusCoreInterface *core)
     J4statusMpdConfig config = {0};
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("MPD");
+    key_file = j4status_config_get_group("MPD");
     if ( key_file != NULL )
     {
         gint64 tmp;
@@ -499,8 +498,6 @@ _j4status_mpd_init(J4statusCoreInterface *core)
         password = g_key_file_get_string(key_file, "MPD", "Password", NULL);
 
         config.actions = j4status_config_key_file_get_actions(key_file, "MPD", _j4status_mpd_action_list, ACTION_NONE);
-
-        g_key_file_free(key_file);
     }
 
     if ( host == NULL )
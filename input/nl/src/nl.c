@@ -834,12 +834,10 @@ _j4status_nl_init(J4statusCoreInterface *core)
     gchar **interfaces = NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Netlink");
+    key_file = j4status_config_get_group("Netlink");
     if ( key_file != NULL )
     {
         interfaces = g_key_file_get_string_list(key_file, "Netlink", "Interfaces", NULL, NULL);
-
-        g_key_file_free(key_file);
     }
 
     if ( interfaces == NULL )
@@ -861,7 +859,7 @@ _j4status_nl_init(J4statusCoreInterface *core)
     gchar *format_up_wifi = NULL;
     gchar *format_down_wifi = NULL;
 
-    key_file = j4status_config_get_key_file("Netlink Formats");
+    key_file = j4status_config_get_group("Netlink Formats");
     if ( key_file != NULL )
     {
         j4status_config_key_file_get_enum(key_file, "Netlink Formats", "Addresses", _j4status_nl_addresses, G_N_ELEMENTS(_j4status_nl_addresses), &addresses);
@@ -869,8 +867,6 @@ _j4status_nl_init(J4statusCoreInterface *core)
         format_down       = g_key_file_get_string(key_file, "Netlink Formats", "Down", NULL);
         format_up_wifi    = g_key_file_get_string(key_file, "Netlink Formats", "UpWiFi", NULL);
         format_down_wifi  = g_key_file_get_string(key_file, "Netlink Formats", "DownWiFi", NULL);
-
-        g_key_file_free(key_file);
     }
 
     self->addresses = addresses;
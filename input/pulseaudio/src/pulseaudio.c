@@ -404,7 +404,7 @@ _j4status_pulseaudio_init(J4statusCoreInterface *core)
     gchar *format = NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("PulseAudio");
+    key_file = j4status_config_get_group("PulseAudio");
     if ( key_file != NULL )
     {
         gint64 value;
@@ -421,8 +421,6 @@ _j4status_pulseaudio_init(J4statusCoreInterface *core)
 
         format = g_key_file_get_string(key_file, "PulseAudio", "Format", NULL);
         config.actions = j4status_config_key_file_get_actions(key_file, "PulseAudio", _j4status_pulseaudio_actions, G_N_ELEMENTS(_j4status_pulseaudio_actions));
-
-        g_key_file_free(key_file);
     }
 
     config.format = j4status_format_string_parse(format, _j4status_pulseaudio_tokens, G_N_ELEMENTS(_j4status_pulseaudio_tokens), J4STATUS_PULSEAUDIO_DEFAULT_FORMAT, NULL);
@@ -337,13 +337,12 @@ _j4status_sensors_init(J4statusCoreInterface *core)
         return NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Sensors");
+    key_file = j4status_config_get_group("Sensors");
     if ( key_file != NULL )
     {
         sensors = g_key_file_get_string_list(key_file, "Sensors", "Sensors", NULL, NULL);
         show_details = g_key_file_get_boolean(key_file, "Sensors", "ShowDetails", NULL);
         interval = g_key_file_get_uint64(key_file, "Sensors", "Interval", NULL);
-        g_key_file_free(key_file);
     }
 
     J4statusPluginContext *context;
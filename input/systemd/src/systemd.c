@@ -251,7 +251,7 @@ J4statusPluginContext *
 _j4status_systemd_init(J4statusCoreInterface *core)
 {
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("systemd");
+    key_file = j4status_config_get_group("systemd");
     if ( key_file == NULL )
     {
         g_message("Missing configuration: No section, aborting");
@@ -264,11 +264,9 @@ _j4status_systemd_init(J4statusCoreInterface *core)
     if ( units == NULL )
     {
         g_message("Missing configuration: Empty list of units to monitor, aborting");
-        g_key_file_free(key_file);
         return NULL;
     }
     masked_states = g_key_file_get_string_list(key_file, "systemd", "MaskedStates", NULL, NULL);
-    g_key_file_free(key_file);
 
     GError *error = NULL;
 
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <string.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -31,48 +32,422 @@
 
 #define TIME_SIZE 4095
 
+#define SECOND 1
+#define MINUTE (60 * SECOND)
+#define HOUR (60 * MINUTE)
+#define DAY (24 * HOUR)
+
+/*
+ * Our deadlines are monotonic, and the monotonic clock stops
+ * during suspend, so we check the wall clock at least this often
+ */
+#define MAX_SLEEP MINUTE
+
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     guint64 interval;
     gchar *format;
+    GHashTable *formats;
     GList *sections;
-    guint timeout_id;
+    GSource *source;
+    guint64 tick;
 };
 
+/*
+ * Formats are compiled once to a list of parts
+ * Hours, minutes and seconds are rendered by hand,
+ * the rest goes through g_date_time_format() and is cached
+ * until its next boundary, which is the next day for most of it
+ */
+typedef enum {
+    J4STATUS_TIME_PART_TEXT,
+    J4STATUS_TIME_PART_CACHED,
+    J4STATUS_TIME_PART_HOUR,
+    J4STATUS_TIME_PART_HOUR_12,
+    J4STATUS_TIME_PART_MINUTE,
+    J4STATUS_TIME_PART_SECOND,
+} J4statusTimePartType;
+
+typedef struct {
+    J4statusTimePartType type;
+    gchar pad;
+    gint64 period;
+    gchar *text;
+} J4statusTimePart;
+
+typedef struct {
+    GArray *parts;
+    gint64 period;
+    gboolean zoned;
+} J4statusTimeFormat;
+
+typedef struct {
+    gchar *text;
+    gint64 until;
+} J4statusTimeCache;
+
 typedef struct {
     J4statusSection *section;
     GTimeZone *tz;
-    gchar *format;
+    J4statusTimeFormat *format;
+    gint64 period;
+    gint64 next;
+    gint64 offset;
+    guint64 tick;
+    J4statusTimeCache *cache;
+    GString *value;
 } J4statusTimeSection;
 
+static void
+_j4status_time_format_add_part(J4statusTimeFormat *self, J4statusTimePartType type, gchar pad, gint64 period, gchar *text)
+{
+    J4statusTimePart part = {
+        .type = type,
+        .pad = pad,
+        .period = period,
+        .text = text,
+    };
+    g_array_append_val(self->parts, part);
+    self->period = MIN(self->period, period);
+}
+
+/* Literals and daily conversions are kept together */
+static void
+_j4status_time_format_flush(J4statusTimeFormat *self, GString *pending, gboolean *conversions)
+{
+    if ( pending->len == 0 )
+        return;
+
+    _j4status_time_format_add_part(self, *conversions ? J4STATUS_TIME_PART_CACHED : J4STATUS_TIME_PART_TEXT, '\0', DAY, g_strndup(pending->str, pending->len));
+    g_string_truncate(pending, 0);
+    *conversions = FALSE;
+}
+
+static void
+_j4status_time_format_add_number(J4statusTimeFormat *self, gchar conversion, gchar flag)
+{
+    gchar pad = '0';
+    switch ( conversion )
+    {
+    case 'k':
+    case 'l':
+        pad = ' ';
+    break;
+    }
+    switch ( flag )
+    {
+    case '_':
+        pad = ' ';
+    break;
+    case '-':
+        pad = '\0';
+    break;
+    case '0':
+        pad = '0';
+    break;
+    }
+
+    switch ( conversion )
+    {
+    case 'H':
+    case 'k':
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_HOUR, pad, HOUR, NULL);
+    break;
+    case 'I':
+    case 'l':
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_HOUR_12, pad, HOUR, NULL);
+    break;
+    case 'M':
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_MINUTE, pad, MINUTE, NULL);
+    break;
+    case 'S':
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_SECOND, pad, SECOND, NULL);
+    break;
+    case 'R':
+    case 'T':
+        _j4status_time_format_add_number(self, 'H', '\0');
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_TEXT, '\0', DAY, g_strdup(":"));
+        _j4status_time_format_add_number(self, 'M', '\0');
+        if ( conversion == 'R' )
+            break;
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_TEXT, '\0', DAY, g_strdup(":"));
+        _j4status_time_format_add_number(self, 'S', '\0');
+    break;
+    }
+}
+
+static J4statusTimeFormat *
+_j4status_time_format_new(const gchar *source)
+{
+    J4statusTimeFormat *self;
+
+    self = g_slice_new0(J4statusTimeFormat);
+    self->parts = g_array_new(FALSE, FALSE, sizeof(J4statusTimePart));
+    self->period = DAY;
+
+    GString *pending = g_string_new("");
+    gboolean conversions = FALSE;
+    const gchar *c = source;
+    while ( *c != '\0' )
+    {
+        if ( *c != '%' )
+        {
+            g_string_append_c(pending, *c++);
+            continue;
+        }
+
+        const gchar *start = c++;
+        gchar flag = '\0';
+        gboolean plain = TRUE;
+
+        /* Flags, width and modifiers */
+        while ( ( *c != '\0' ) && ( g_ascii_isdigit(*c) || ( strchr("_-^#:EO", *c) != NULL ) ) )
+        {
+            if ( ( flag == '\0' ) && ( strchr("_-0", *c) != NULL ) )
+                flag = *c;
+            else
+                plain = FALSE;
+            ++c;
+        }
+
+        if ( *c == '\0' )
+        {
+            g_string_append(pending, start);
+            conversions = TRUE;
+            break;
+        }
+
+        /* Anything we do not know about is assumed to change every second */
+        gint64 period = SECOND;
+        switch ( *c )
+        {
+        case '%': case 'n': case 't':
+        case 'a': case 'A': case 'b': case 'B': case 'h':
+        case 'C': case 'd': case 'D': case 'e': case 'F':
+        case 'g': case 'G': case 'j': case 'm': case 'u':
+        case 'U': case 'V': case 'w': case 'W': case 'x':
+        case 'y': case 'Y':
+            g_string_append_len(pending, start, c + 1 - start);
+            conversions = TRUE;
+            ++c;
+            continue;
+        case 'R':
+        case 'T':
+            plain = plain && ( flag == '\0' );
+        /* fallthrough */
+        case 'H': case 'k': case 'I': case 'l': case 'M': case 'S':
+            if ( plain )
+            {
+                _j4status_time_format_flush(self, pending, &conversions);
+                _j4status_time_format_add_number(self, *c, flag);
+                ++c;
+                continue;
+            }
+            if ( strchr("HkIl", *c) != NULL )
+                period = HOUR;
+            else if ( strchr("MR", *c) != NULL )
+                period = MINUTE;
+        break;
+        case 'Z':
+            self->zoned = TRUE;
+        /* fallthrough */
+        case 'p': case 'P': case 'z':
+            period = HOUR;
+        break;
+        }
+
+        _j4status_time_format_flush(self, pending, &conversions);
+        _j4status_time_format_add_part(self, J4STATUS_TIME_PART_CACHED, '\0', period, g_strndup(start, c + 1 - start));
+        ++c;
+    }
+    _j4status_time_format_flush(self, pending, &conversions);
+    g_string_free(pending, TRUE);
+
+    return self;
+}
+
+static void
+_j4status_time_format_free(gpointer data)
+{
+    J4statusTimeFormat *self = data;
+
+    guint i;
+    for ( i = 0 ; i < self->parts->len ; ++i )
+        g_free(g_array_index(self->parts, J4statusTimePart, i).text);
+    g_array_free(self->parts, TRUE);
+
+    g_slice_free(J4statusTimeFormat, self);
+}
+
+static J4statusTimeFormat *
+_j4status_time_format_get(J4statusPluginContext *context, const gchar *source)
+{
+    J4statusTimeFormat *format;
+    format = g_hash_table_lookup(context->formats, source);
+    if ( format == NULL )
+    {
+        format = _j4status_time_format_new(source);
+        g_hash_table_insert(context->formats, g_strdup(source), format);
+    }
+    return format;
+}
+
+static void
+_j4status_time_append_number(GString *string, guint n, gchar pad)
+{
+    if ( n >= 10 )
+        g_string_append_c(string, '0' + n / 10);
+    else if ( pad != '\0' )
+        g_string_append_c(string, pad);
+    g_string_append_c(string, '0' + n % 10);
+}
+
+static void
+_j4status_time_section_render(J4statusTimeSection *section, gint64 now)
+{
+    J4statusTimeFormat *format = section->format;
+    GDateTime *date_time = NULL;
+    gint64 local = now + section->offset;
+    gint64 seconds = local % DAY;
+    guint hour;
+
+    g_string_truncate(section->value, 0);
+
+    guint i;
+    for ( i = 0 ; i < format->parts->len ; ++i )
+    {
+        J4statusTimePart *part = &g_array_index(format->parts, J4statusTimePart, i);
+        J4statusTimeCache *cache = &section->cache[i];
+        switch ( part->type )
+        {
+        case J4STATUS_TIME_PART_TEXT:
+            g_string_append(section->value, part->text);
+        break;
+        case J4STATUS_TIME_PART_CACHED:
+            if ( local >= cache->until )
+            {
+                if ( date_time == NULL )
+                {
+                    GDateTime *utc;
+                    utc = g_date_time_new_from_unix_utc(now);
+                    date_time = g_date_time_to_timezone(utc, section->tz);
+                    g_date_time_unref(utc);
+                }
+                g_free(cache->text);
+                cache->text = g_date_time_format(date_time, part->text);
+                cache->until = local - ( local % part->period ) + part->period;
+            }
+            if ( cache->text != NULL )
+                g_string_append(section->value, cache->text);
+        break;
+        case J4STATUS_TIME_PART_HOUR:
+            _j4status_time_append_number(section->value, seconds / HOUR, part->pad);
+        break;
+        case J4STATUS_TIME_PART_HOUR_12:
+            hour = ( seconds / HOUR ) % 12;
+            _j4status_time_append_number(section->value, ( hour == 0 ) ? 12 : hour, part->pad);
+        break;
+        case J4STATUS_TIME_PART_MINUTE:
+            _j4status_time_append_number(section->value, ( seconds % HOUR ) / MINUTE, part->pad);
+        break;
+        case J4STATUS_TIME_PART_SECOND:
+            _j4status_time_append_number(section->value, seconds % MINUTE, part->pad);
+        break;
+        }
+    }
+
+    if ( date_time != NULL )
+        g_date_time_unref(date_time);
+}
+
+/*
+ * Only zones which reached their next boundary are formatted
+ * and we sleep until the closest one
+ * Zones with the same format and UTC offset share a rendering,
+ * unless the format shows the zone name
+ */
 static gboolean
 _j4status_time_update(gpointer user_data)
 {
     J4statusPluginContext *context = user_data;
-    GDateTime *date_time;
-    GDateTime *zone_date_time;
-    date_time = g_date_time_new_now_utc();
+    gint64 real = g_get_real_time();
+    gint64 now = real / G_USEC_PER_SEC;
+    gint64 next = G_MAXINT64;
+
+    ++context->tick;
 
     GList *section_;
     for ( section_ = context->sections ; section_ != NULL ; section_ = g_list_next(section_) )
     {
         J4statusTimeSection *section = section_->data;
-        zone_date_time = g_date_time_to_timezone(date_time, section->tz);
-        j4status_section_set_value(section->section, g_date_time_format(zone_date_time, ( section->format != NULL ) ? section->format : context->format));
-        g_date_time_unref(zone_date_time);
+        /* The wall clock may have gone backwards */
+        if ( ( section->next > real ) && ( ( section->next - real ) <= section->period * G_USEC_PER_SEC ) )
+        {
+            next = MIN(next, section->next);
+            continue;
+        }
+
+        gint64 offset;
+        offset = g_time_zone_get_offset(section->tz, g_time_zone_find_interval(section->tz, G_TIME_TYPE_UNIVERSAL, now));
+
+        J4statusTimeSection *shared = NULL;
+        GList *other_;
+        for ( other_ = context->sections ; ( shared == NULL ) && ( ! section->format->zoned ) && ( other_ != section_ ) ; other_ = g_list_next(other_) )
+        {
+            J4statusTimeSection *other = other_->data;
+            if ( ( other->tick == context->tick ) && ( other->format == section->format ) && ( other->offset == offset ) )
+                shared = other;
+        }
+
+        if ( shared != NULL )
+            j4status_section_set_value_copy(section->section, shared->value->str);
+        else
+        {
+            if ( section->offset != offset )
+            {
+                /* Cached parts are keyed on local time */
+                guint i;
+                for ( i = 0 ; i < section->format->parts->len ; ++i )
+                    section->cache[i].until = 0;
+                section->offset = offset;
+            }
+            _j4status_time_section_render(section, now);
+            section->tick = context->tick;
+            j4status_section_set_value_copy(section->section, section->value->str);
+        }
+
+        /* Boundaries are in local time, so that days start at midnight */
+        gint64 local = now + offset;
+        section->next = ( now - ( local % section->period ) + section->period ) * G_USEC_PER_SEC;
+        next = MIN(next, section->next);
     }
 
-    g_date_time_unref(date_time);
+    g_source_set_ready_time(context->source, g_get_monotonic_time() + MIN(next - real, MAX_SLEEP * G_USEC_PER_SEC));
 
     return G_SOURCE_CONTINUE;
 }
 
+/* A timer with an absolute deadline, see _j4status_time_update() */
+static gboolean
+_j4status_time_source_dispatch(G_GNUC_UNUSED GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    return callback(user_data);
+}
+
+static GSourceFuncs _j4status_time_source_funcs = {
+    .dispatch = _j4status_time_source_dispatch,
+};
+
 static void
 _j4status_time_section_free(gpointer data)
 {
     J4statusTimeSection *section = data;
 
-    g_free(section->format);
+    guint i;
+    for ( i = 0 ; i < section->format->parts->len ; ++i )
+        g_free(section->cache[i].text);
+    g_free(section->cache);
+    g_string_free(section->value, TRUE);
     g_time_zone_unref(section->tz);
 
 
@@ -88,8 +463,12 @@ _j4status_time_section_new(J4statusPluginContext *context, const gchar *timezone
 
     section = g_new0(J4statusTimeSection, 1);
     section->tz = ( timezone != NULL ) ? g_time_zone_new(timezone) : g_time_zone_new_local();
-    section->format = format;
+    section->format = _j4status_time_format_get(context, ( format != NULL ) ? format : context->format);
+    section->period = MAX(section->format->period, (gint64) context->interval);
+    section->cache = g_new0(J4statusTimeCache, section->format->parts->len);
+    section->value = g_string_sized_new(64);
     section->section = j4status_section_new(context->core);
+    g_free(format);
 
     timezone = ( timezone != NULL ) ? timezone : "local";
 
@@ -111,13 +490,14 @@ _j4status_time_init(J4statusCoreInterface *core)
 
     context = g_new0(J4statusPluginContext, 1);
     context->core = core;
+    context->formats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _j4status_time_format_free);
 
     context->format = g_strdup("%F %T");
     gchar **timezones = NULL;
     gchar **formats = NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Time");
+    key_file = j4status_config_get_group("Time");
     if ( key_file != NULL )
     {
         context->interval = g_key_file_get_uint64(key_file, "Time", "Interval", NULL);
@@ -141,8 +521,6 @@ _j4status_time_init(J4statusCoreInterface *core)
             g_strfreev(formats);
             formats = NULL;
         }
-
-        g_key_file_free(key_file);
     }
     if ( context->interval < 1 )
         context->interval = 1;
@@ -187,6 +565,7 @@ static void
 _j4status_time_uninit(J4statusPluginContext *context)
 {
     g_list_free_full(context->sections, _j4status_time_section_free);
+    g_hash_table_unref(context->formats);
 
     g_free(context->format);
 
@@ -196,15 +575,22 @@ _j4status_time_uninit(J4statusPluginContext *context)
 static void
 _j4status_time_start(J4statusPluginContext *context)
 {
+    GList *section;
+    for ( section = context->sections ; section != NULL ; section = g_list_next(section) )
+        ((J4statusTimeSection *) section->data)->next = 0;
+
+    context->source = g_source_new(&_j4status_time_source_funcs, sizeof(GSource));
+    g_source_set_callback(context->source, _j4status_time_update, context, NULL);
     _j4status_time_update(context);
-    context->timeout_id = g_timeout_add_seconds(context->interval, _j4status_time_update, context);
+    g_source_attach(context->source, NULL);
 }
 
 static void
 _j4status_time_stop(J4statusPluginContext *context)
 {
-    g_source_remove(context->timeout_id);
-    context->timeout_id = 0;
+    g_source_destroy(context->source);
+    g_source_unref(context->source);
+    context->source = NULL;
 }
 
 J4STATUS_EXPORT void
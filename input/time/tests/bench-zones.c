@@ -0,0 +1,78 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Formats 100 zones per tick, every zone being due on every tick
+ * Zones come four by offset, to cover shared renderings
+ */
+
+#include "../src/time.c"
+
+#include "test-core.h"
+
+#define ZONES 100
+#define TICKS 10000
+
+int
+main(int argc, char *argv[])
+{
+    J4statusCoreInterface core;
+    J4statusPluginContext *context;
+
+    j4status_test_core_init(&core);
+
+    context = g_new0(J4statusPluginContext, 1);
+    context->core = &core;
+    context->interval = 1;
+    context->format = g_strdup(( argc > 1 ) ? argv[1] : "%F %T");
+    context->formats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _j4status_time_format_free);
+
+    guint i;
+    for ( i = 0 ; i < ZONES ; ++i )
+    {
+        gchar zone[16];
+        gint minutes = ( (gint) ( i / 4 ) - 12 ) * 30;
+        g_snprintf(zone, sizeof(zone), "%c%02d:%02d", ( minutes < 0 ) ? '-' : '+', ABS(minutes) / 60, ABS(minutes) % 60);
+        _j4status_time_section_new(context, zone, NULL);
+    }
+
+    context->source = g_source_new(&_j4status_time_source_funcs, sizeof(GSource));
+
+    gint64 start = g_get_monotonic_time();
+    guint tick;
+    for ( tick = 0 ; tick < TICKS ; ++tick )
+    {
+        GList *section;
+        for ( section = context->sections ; section != NULL ; section = g_list_next(section) )
+            ((J4statusTimeSection *) section->data)->next = 0;
+        _j4status_time_update(context);
+    }
+    gint64 duration = g_get_monotonic_time() - start;
+
+    g_print("%u zones, %u ticks: %.3f µs per tick, %.1f ns per zone\n", ZONES, TICKS, (gdouble) duration / TICKS, (gdouble) duration * 1000. / TICKS / ZONES);
+
+    g_source_unref(context->source);
+    context->source = NULL;
+    _j4status_time_uninit(context);
+
+    return 0;
+}
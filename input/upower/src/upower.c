@@ -260,12 +260,11 @@ _j4status_upower_init(J4statusCoreInterface *core)
     gchar *format = NULL;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("UPower");
+    key_file = j4status_config_get_group("UPower");
     if ( key_file != NULL )
     {
         all_devices = g_key_file_get_boolean(key_file, "UPower", "AllDevices", NULL);
         format = g_key_file_get_string(key_file, "UPower", "Format", NULL);
-        g_key_file_free(key_file);
     }
     context->format = j4status_format_string_parse(format, _j4status_upower_format_tokens, G_N_ELEMENTS(_j4status_upower_format_tokens), J4STATUS_UPOWER_DEFAULT_FORMAT, NULL);
 
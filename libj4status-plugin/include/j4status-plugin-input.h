@@ -33,6 +33,7 @@ LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(input, Input, init, Init);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(input, Input, uninit, Simple);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(input, Input, start, Simple);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(input, Input, stop, Simple);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(input, Input, dump_stats, DumpStats);
 
 J4statusSection *j4status_section_new(J4statusCoreInterface *core);
 void j4status_section_free(J4statusSection *section);
@@ -52,6 +53,7 @@ void j4status_section_set_state(J4statusSection *section, J4statusState state);
 void j4status_section_set_colour(J4statusSection *section, J4statusColour colour);
 void j4status_section_set_background_colour(J4statusSection *section, J4statusColour colour);
 void j4status_section_set_value(J4statusSection *section, gchar *value);
+void j4status_section_set_value_copy(J4statusSection *section, const gchar *value);
 void j4status_section_set_short_value(J4statusSection *section, gchar *short_value);
 
 #endif /* __J4STATUS_J4STATUS_PLUGIN_INPUT_H__ */
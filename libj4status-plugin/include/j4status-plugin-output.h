@@ -30,15 +30,43 @@ typedef struct _J4statusIOStream J4statusCoreStream;
 typedef struct _J4statusOutputPluginStream J4statusOutputPluginStream;
 
 void j4status_core_trigger_action(J4statusCoreInterface *core, const gchar *section_id, const gchar *event_id);
+void j4status_core_set_tracing(J4statusCoreInterface *core, gboolean tracing);
 GInputStream *j4status_core_stream_get_input_stream(J4statusCoreInterface *core, J4statusCoreStream *stream);
 GOutputStream *j4status_core_stream_get_output_stream(J4statusCoreInterface *core, J4statusCoreStream *stream);
 void j4status_core_stream_reconnect(J4statusCoreInterface *core, J4statusCoreStream *stream);
+gboolean j4status_core_stream_is_terminal(J4statusCoreInterface *core, J4statusCoreStream *stream);
 void j4status_core_stream_free(J4statusCoreInterface *core, J4statusCoreStream *stream);
 
+typedef enum {
+    J4STATUS_TRACE_SECTION_UPDATE,
+    J4STATUS_TRACE_GENERATE,
+    J4STATUS_TRACE_STREAM_WRITE,
+} J4statusTraceType;
+
+/*
+ * Times are from g_get_monotonic_time()
+ * name is the section id for updates, the output plugin name otherwise
+ * source is the input plugin name, for updates
+ * stream and size are only set for writes
+ */
+typedef struct {
+    J4statusTraceType type;
+    const gchar *name;
+    const gchar *source;
+    guint64 stream;
+    gint64 start;
+    gint64 duration;
+    gsize size;
+} J4statusTraceEvent;
+
 typedef gboolean (*J4statusPluginSendFunc)(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error);
 typedef void (*J4statusPluginGenerateLineFunc)(J4statusPluginContext *context, GList *sections);
+typedef void (*J4statusPluginGenerateLineArrayFunc)(J4statusPluginContext *context, J4statusSection * const *sections, gsize length);
+typedef void (*J4statusPluginGenerateLineIncrementalFunc)(J4statusPluginContext *context, J4statusSection * const *sections, gsize length, J4statusSection * const *dirty, gsize dirty_length);
+typedef gboolean (*J4statusPluginGetLineFunc)(J4statusPluginContext *context, GPtrArray *chunks);
 typedef J4statusOutputPluginStream *(*J4statusPluginStreamNewFunc)(J4statusPluginContext *context, J4statusCoreStream *stream);
 typedef void (*J4statusPluginStreamFunc)(J4statusPluginContext *context, J4statusOutputPluginStream *stream);
+typedef void (*J4statusPluginTraceFunc)(J4statusPluginContext *context, const J4statusTraceEvent *event);
 
 typedef struct _J4statusOutputPluginInterface J4statusOutputPluginInterface;
 
@@ -48,13 +76,19 @@ LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, init, Init);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, uninit, Simple);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, send_header, Send);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, generate_line, GenerateLine);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, generate_line_array, GenerateLineArray);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, generate_line_incremental, GenerateLineIncremental);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, send_line, Send);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, get_line, GetLine);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, stream_new, StreamNew);
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, stream_free, Stream);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, dump_stats, DumpStats);
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(output, Output, trace, Trace);
 
 const gchar *j4status_section_get_name(const J4statusSection *section);
 const gchar *j4status_section_get_instance(const J4statusSection *section);
 const gchar *j4status_section_get_label(const J4statusSection *section);
+gsize j4status_section_get_label_width(const J4statusSection *section);
 J4statusColour j4status_section_get_label_colour(const J4statusSection *section);
 J4statusAlign j4status_section_get_align(const J4statusSection *section);
 gint64 j4status_section_get_max_width(const J4statusSection *section);
@@ -62,6 +96,7 @@ J4statusState j4status_section_get_state(const J4statusSection *section);
 J4statusColour j4status_section_get_colour(const J4statusSection *section);
 J4statusColour j4status_section_get_background_colour(const J4statusSection *section);
 const gchar *j4status_section_get_value(const J4statusSection *section);
+gsize j4status_section_get_value_width(const J4statusSection *section);
 const gchar *j4status_section_get_short_value(const J4statusSection *section);
 
 gboolean j4status_section_is_dirty(const J4statusSection *section);
@@ -69,5 +104,6 @@ void j4status_section_set_cache(J4statusSection *section, gchar *cache);
 const gchar *j4status_section_get_cache(const J4statusSection *section);
 void j4status_section_set_output_user_data(J4statusSection *section, gpointer user_data, GDestroyNotify notify);
 gpointer j4status_section_get_output_user_data(J4statusSection *section);
+void j4status_section_trigger_action(J4statusSection *section, const gchar *event_id);
 
 #endif /* __J4STATUS_J4STATUS_PLUGIN_OUTPUT_H__ */
@@ -23,22 +23,34 @@
 #ifndef __J4STATUS_J4STATUS_PLUGIN_PRIVATE_H__
 #define __J4STATUS_J4STATUS_PLUGIN_PRIVATE_H__
 
+typedef struct {
+    gchar *cache;
+    gpointer user_data;
+    GDestroyNotify notify;
+} J4statusSectionOutput;
+
 struct _J4statusSection {
     J4statusCoreInterface *core;
     gboolean freeze;
     gchar *id;
     /* Reserved for the core */
     gint64 weight;
-    GList *link;
+    guint64 serial;
+    guint index;
+    guint64 updates;
+    guint64 setter_calls;
 
     /* Input plugins can only touch these
      * before inserting the section in the list */
     gchar *name;
     gchar *instance;
     gchar *label;
+    gsize label_width;
     J4statusColour label_colour;
     J4statusAlign align;
     gint64 max_width;
+    /* Only set from the configuration, plugins use max_width as a padding */
+    gsize truncate_width;
     struct {
         J4statusSectionActionCallback callback;
         gpointer user_data;
@@ -50,38 +62,48 @@ struct _J4statusSection {
     J4statusColour colour;
     J4statusColour background_colour;
     gchar *value;
+    gsize value_size;
+    gsize value_width;
     gchar *short_value;
 
-    /* Reserved for the output plugin */
+    /* Reserved for the output plugins, one slot per output */
     gboolean dirty;
-    gchar *cache;
-    struct {
-        gpointer user_data;
-        GDestroyNotify notify;
-    } output;
+    J4statusSectionOutput *outputs;
+    guint outputs_size;
 };
 
+GKeyFile *j4status_config_get_override(const gchar *id, const gchar **group_name);
+
 typedef struct _J4statusCoreContext J4statusCoreContext;
 
 typedef void (*J4statusCoreFunc)(J4statusCoreContext *context);
+typedef guint (*J4statusCoreGetOutputFunc)(J4statusCoreContext *context);
+typedef void (*J4statusCoreSetTracingFunc)(J4statusCoreContext *context, gboolean tracing);
 typedef gboolean (*J4statusCoreSectionAddFunc)(J4statusCoreContext *context, J4statusSection *section);
 typedef void (*J4statusCoreSectionFunc)(J4statusCoreContext *context, J4statusSection *section);
-typedef void (*J4statusCoreTriggerGenerateFunc)(J4statusCoreContext *context, gboolean force);
+typedef void (*J4statusCoreSectionUpdateFunc)(J4statusCoreContext *context, J4statusSection *section, gboolean force);
 typedef void (*J4statusCoreTriggerActionFunc)(J4statusCoreContext *context, const gchar *section_id, const gchar *event_id);
 typedef GInputStream *(*J4statusCoreStreamGetInputStreamFunc)(J4statusCoreStream *stream);
 typedef GOutputStream *(*J4statusCoreStreamGetOutputStreamFunc)(J4statusCoreStream *stream);
 typedef void (*J4statusCoreStreamFunc)(J4statusCoreStream *stream);
+typedef gboolean (*J4statusCoreStreamIsTerminalFunc)(J4statusCoreStream *stream);
 
 struct _J4statusCoreInterface {
     J4statusCoreContext *context;
     J4statusCoreSectionAddFunc add_section;
     J4statusCoreSectionFunc remove_section;
-    J4statusCoreTriggerGenerateFunc trigger_generate;
+    J4statusCoreSectionUpdateFunc update_section;
     J4statusCoreTriggerActionFunc trigger_action;
+    J4statusCoreGetOutputFunc get_output;
+    J4statusCoreSetTracingFunc set_tracing;
     J4statusCoreStreamGetInputStreamFunc stream_get_input_stream;
     J4statusCoreStreamGetOutputStreamFunc stream_get_output_stream;
     J4statusCoreStreamFunc stream_reconnect;
     J4statusCoreStreamFunc stream_free;
+    J4statusCoreStreamIsTerminalFunc stream_is_terminal;
+
+    /* Reserved for the core */
+    gpointer plugin;
 };
 
 
@@ -94,7 +116,13 @@ struct _J4statusOutputPluginInterface {
 
     J4statusPluginSendFunc         send_header;
     J4statusPluginGenerateLineFunc generate_line;
+    J4statusPluginGenerateLineArrayFunc generate_line_array;
+    J4statusPluginGenerateLineIncrementalFunc generate_line_incremental;
     J4statusPluginSendFunc         send_line;
+    J4statusPluginGetLineFunc      get_line;
+
+    J4statusPluginDumpStatsFunc dump_stats;
+    J4statusPluginTraceFunc trace;
 };
 
 struct _J4statusInputPluginInterface {
@@ -103,6 +131,8 @@ struct _J4statusInputPluginInterface {
 
     J4statusPluginSimpleFunc start;
     J4statusPluginSimpleFunc stop;
+
+    J4statusPluginDumpStatsFunc dump_stats;
 };
 
 #endif /* __J4STATUS_J4STATUS_PLUGIN_PRIVATE_H__ */
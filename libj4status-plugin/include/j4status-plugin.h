@@ -32,6 +32,7 @@ typedef struct _J4statusPluginContext J4statusPluginContext;
 
 typedef J4statusPluginContext *(*J4statusPluginInitFunc)(J4statusCoreInterface *core);
 typedef void(*J4statusPluginSimpleFunc)(J4statusPluginContext *context);
+typedef void(*J4statusPluginDumpStatsFunc)(J4statusPluginContext *context, GKeyFile *key_file, const gchar *group);
 
 
 #define LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK(type, Type, action, Action) void libj4status_##type##_plugin_interface_add_##action##_callback(J4status##Type##PluginInterface *interface, J4statusPlugin##Action##Func callback)
@@ -55,6 +56,7 @@ typedef enum {
 
 #define J4STATUS_STATE_FLAGS (J4STATUS_STATE_URGENT)
 
+GKeyFile *j4status_config_get_group(const gchar *group_name);
 GKeyFile *j4status_config_get_key_file(const gchar *section);
 gboolean j4status_config_key_file_get_enum(GKeyFile *key_file, const gchar *group_name, const gchar *key, const gchar * const *values, guint64 size, guint64 *value);
 GHashTable *j4status_config_key_file_get_actions(GKeyFile *key_file, const gchar *group_name, const gchar * const *values, guint64 size);
@@ -32,68 +32,147 @@
 #define CONFIG_DATAFILE    J4STATUS_DATADIR    G_DIR_SEPARATOR_S PACKAGE_NAME G_DIR_SEPARATOR_S "config"
 #define CONFIG_LIBFILE     J4STATUS_LIBDIR     G_DIR_SEPARATOR_S PACKAGE_NAME G_DIR_SEPARATOR_S "config"
 
-static GKeyFile *
-_j4status_config_try_dir(const gchar *filename, const gchar *section)
+#define OVERRIDE_PREFIX "Override "
+
+typedef struct {
+    gboolean loaded;
+    GList *key_files;
+    GHashTable *groups;
+    GHashTable *overrides;
+} J4statusConfig;
+
+static J4statusConfig _j4status_config;
+
+static void
+_j4status_config_try_file(J4statusConfig *self, const gchar *filename)
 {
-    GKeyFile *key_file = NULL;
-    if ( g_file_test(filename, G_FILE_TEST_EXISTS) && ( ! g_file_test(filename, G_FILE_TEST_IS_DIR) ) )
+    if ( ( ! g_file_test(filename, G_FILE_TEST_EXISTS) ) || g_file_test(filename, G_FILE_TEST_IS_DIR) )
+        return;
+
+    GError *error = NULL;
+    GKeyFile *key_file;
+    key_file = g_key_file_new();
+    if ( ! g_key_file_load_from_file(key_file, filename, 0, &error) )
     {
-        GError *error = NULL;
-        key_file = g_key_file_new();
-        if ( ! g_key_file_load_from_file(key_file, filename, 0, &error) )
-        {
-            g_key_file_free(key_file);
-            g_warning("Couldn't load key_file '%s': %s", filename, error->message);
-            g_clear_error(&error);
-            return NULL;
-        }
-        if ( g_key_file_has_group(key_file, section) )
-            return key_file;
-        else
+        g_key_file_free(key_file);
+        g_warning("Couldn't load key_file '%s': %s", filename, error->message);
+        g_clear_error(&error);
+        return;
+    }
+
+    gboolean used = FALSE;
+    gchar **groups, **group;
+    groups = g_key_file_get_groups(key_file, NULL);
+    for ( group = groups ; *group != NULL ; ++group )
+    {
+        /* First file with a group wins, like the search order used to */
+        if ( g_hash_table_contains(self->groups, *group) )
         {
-            g_key_file_free(key_file);
-            return NULL;
+            g_free(*group);
+            continue;
         }
+
+        used = TRUE;
+        g_hash_table_insert(self->groups, *group, key_file);
+        if ( g_str_has_prefix(*group, OVERRIDE_PREFIX) )
+            g_hash_table_insert(self->overrides, *group + strlen(OVERRIDE_PREFIX), *group);
     }
-    return key_file;
-}
+    g_free(groups);
 
+    if ( used )
+        self->key_files = g_list_prepend(self->key_files, key_file);
+    else
+        g_key_file_free(key_file);
+}
 
-J4STATUS_EXPORT GKeyFile *
-j4status_config_get_key_file(const gchar *section)
+static J4statusConfig *
+_j4status_config_get(void)
 {
-    GKeyFile *key_file;
-    gchar *file = NULL;
+    J4statusConfig *self = &_j4status_config;
+    if ( self->loaded )
+        return self;
+    self->loaded = TRUE;
+
+    self->groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    self->overrides = g_hash_table_new(g_str_hash, g_str_equal);
+
+    gchar *file;
 
     const gchar *env_file;
     env_file = g_getenv("J4STATUS_CONFIG_FILE");
     if ( env_file != NULL )
     {
+        file = NULL;
         if ( strchr(env_file, G_DIR_SEPARATOR) == NULL )
             env_file = file = g_build_filename(g_get_user_config_dir(), PACKAGE_NAME, env_file, NULL);
-        key_file = _j4status_config_try_dir(env_file, section);
+        _j4status_config_try_file(self, env_file);
         g_free(file);
-        if ( key_file != NULL )
-            return key_file;
     }
 
     file = g_build_filename(g_get_user_config_dir(), PACKAGE_NAME G_DIR_SEPARATOR_S "config", NULL);
-    key_file = _j4status_config_try_dir(file, section);
+    _j4status_config_try_file(self, file);
     g_free(file);
-    if ( key_file != NULL )
-        return key_file;
-
-    key_file = _j4status_config_try_dir(CONFIG_SYSCONFFILE, section);
-    if ( key_file != NULL )
-        return key_file;
-    key_file = _j4status_config_try_dir(CONFIG_DATAFILE, section);
-    if ( key_file != NULL )
-        return key_file;
-    key_file = _j4status_config_try_dir(CONFIG_LIBFILE, section);
-    if ( key_file != NULL )
-        return key_file;
-
-    return NULL;
+
+    _j4status_config_try_file(self, CONFIG_SYSCONFFILE);
+    _j4status_config_try_file(self, CONFIG_DATAFILE);
+    _j4status_config_try_file(self, CONFIG_LIBFILE);
+
+    return self;
+}
+
+/*
+ * Returns the shared key file holding group_name, owned by the config index
+ * Callers must not free it
+ */
+J4STATUS_EXPORT GKeyFile *
+j4status_config_get_group(const gchar *group_name)
+{
+    g_return_val_if_fail(group_name != NULL, NULL);
+
+    return g_hash_table_lookup(_j4status_config_get()->groups, group_name);
+}
+
+GKeyFile *
+j4status_config_get_override(const gchar *id, const gchar **group_name)
+{
+    J4statusConfig *self = _j4status_config_get();
+
+    const gchar *group;
+    group = g_hash_table_lookup(self->overrides, id);
+    if ( group == NULL )
+        return NULL;
+
+    *group_name = group;
+    return g_hash_table_lookup(self->groups, group);
+}
+
+/*
+ * Kept for plugins which free the key file they get:
+ * we hand them a private copy of the group
+ */
+J4STATUS_EXPORT GKeyFile *
+j4status_config_get_key_file(const gchar *section)
+{
+    GKeyFile *shared;
+    shared = j4status_config_get_group(section);
+    if ( shared == NULL )
+        return NULL;
+
+    GKeyFile *key_file;
+    key_file = g_key_file_new();
+
+    gchar **keys, **key;
+    keys = g_key_file_get_keys(shared, section, NULL, NULL);
+    for ( key = keys ; *key != NULL ; ++key )
+    {
+        gchar *value;
+        value = g_key_file_get_value(shared, section, *key, NULL);
+        g_key_file_set_value(key_file, section, *key, value);
+        g_free(value);
+    }
+    g_strfreev(keys);
+
+    return key_file;
 }
 
 J4STATUS_EXPORT gboolean
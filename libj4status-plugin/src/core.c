@@ -34,6 +34,12 @@ j4status_core_trigger_action(J4statusCoreInterface *core, const gchar *section_i
     return core->trigger_action(core->context, section_id, event_id);
 }
 
+J4STATUS_EXPORT void
+j4status_core_set_tracing(J4statusCoreInterface *core, gboolean tracing)
+{
+    return core->set_tracing(core->context, tracing);
+}
+
 
 J4STATUS_EXPORT GInputStream *
 j4status_core_stream_get_input_stream(J4statusCoreInterface *core, J4statusCoreStream *stream)
@@ -53,6 +59,12 @@ j4status_core_stream_reconnect(J4statusCoreInterface *core, J4statusCoreStream *
     return core->stream_reconnect(stream);
 }
 
+J4STATUS_EXPORT gboolean
+j4status_core_stream_is_terminal(J4statusCoreInterface *core, J4statusCoreStream *stream)
+{
+    return core->stream_is_terminal(stream);
+}
+
 J4STATUS_EXPORT void
 j4status_core_stream_free(J4statusCoreInterface *core, J4statusCoreStream *stream)
 {
@@ -36,9 +36,15 @@ LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, stream_new, Stream
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, stream_free, Stream)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, send_header, Send)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, generate_line, GenerateLine)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, generate_line_array, GenerateLineArray)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, generate_line_incremental, GenerateLineIncremental)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, send_line, Send)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, get_line, GetLine)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, dump_stats, DumpStats)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(output, Output, trace, Trace)
 
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(input, Input, init, Init)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(input, Input, uninit, Simple)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(input, Input, start, Simple)
 LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(input, Input, stop, Simple)
+LIBJ4STATUS_PLUGIN_INTERFACE_ADD_CALLBACK_DEF(input, Input, dump_stats, DumpStats)
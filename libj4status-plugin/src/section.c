@@ -25,35 +25,33 @@
 #include <string.h>
 
 #include <glib.h>
-#include <glib/gprintf.h>
 
 #include "j4status-plugin-output.h"
 #include "j4status-plugin-input.h"
 #include "j4status-plugin-private.h"
 #include "j4status-plugin.h"
 
-static gboolean
-_j4status_section_get_override(J4statusSection *self)
+static J4statusSectionOutput *
+_j4status_section_get_output(J4statusSection *self)
 {
-    gsize l;
-    gchar *group;
-
-    /* id is always at least as long as name */
-    l = strlen("Override ") + strlen(self->id) + 1;
-    group = g_newa(gchar, l);
-
-    g_sprintf(group, "Override %s", self->id);
-
-    GKeyFile *key_file;
-    key_file = j4status_config_get_key_file(group);
-    if ( key_file == NULL )
+    guint output = self->core->get_output(self->core->context);
+    if ( output >= self->outputs_size )
     {
-        if ( self->instance == NULL )
-            return TRUE;
-        g_sprintf(group, "Override %s", self->name);
+        self->outputs = g_renew(J4statusSectionOutput, self->outputs, output + 1);
+        memset(self->outputs + self->outputs_size, 0, ( output + 1 - self->outputs_size ) * sizeof(J4statusSectionOutput));
+        self->outputs_size = output + 1;
     }
+    return &self->outputs[output];
+}
 
-    key_file = j4status_config_get_key_file(group);
+static gboolean
+_j4status_section_get_override(J4statusSection *self)
+{
+    const gchar *group;
+    GKeyFile *key_file;
+    key_file = j4status_config_get_override(self->id, &group);
+    if ( ( key_file == NULL ) && ( self->instance != NULL ) )
+        key_file = j4status_config_get_override(self->name, &group);
     if ( key_file == NULL )
         return TRUE;
 
@@ -103,14 +101,59 @@ _j4status_section_get_override(J4statusSection *self)
     gint64 max_width;
     max_width = g_key_file_get_int64(key_file, group, "MaxWidth", &error);
     if ( error == NULL )
+    {
         self->max_width = max_width;
+        if ( max_width < 0 )
+            self->truncate_width = -max_width;
+    }
     g_clear_error(&error);
 
 end:
-    g_key_file_free(key_file);
     return insert;
 }
 
+/*
+ * Display width, in terminal cells
+ * Combining marks and control characters take none, East Asian wide characters take two
+ */
+static gsize
+_j4status_section_display_width(const gchar *text, gsize max, const gchar **cut, gsize *cut_width)
+{
+    const gchar *s = text;
+    gsize width = 0;
+
+    while ( *s != '\0' )
+    {
+        gunichar c = g_utf8_get_char_validated(s, -1);
+        const gchar *next;
+        gsize w = 1;
+        if ( c >= (gunichar) -2 )
+            next = s + 1;
+        else
+        {
+            next = g_utf8_next_char(s);
+            if ( g_unichar_iszerowidth(c) || g_unichar_iscntrl(c) )
+                w = 0;
+            else if ( g_unichar_iswide(c) )
+                w = 2;
+        }
+
+        /* Remember where to cut to leave room for the ellipsis */
+        if ( ( max > 0 ) && ( *cut == NULL ) && ( width + w > max - 1 ) )
+        {
+            *cut = s;
+            *cut_width = width;
+        }
+
+        width += w;
+        s = next;
+    }
+
+    return width;
+}
+
+#define ELLIPSIS "…"
+
 /*
  * Input plugins API
  */
@@ -133,14 +176,19 @@ j4status_section_free(J4statusSection *self)
 {
     g_return_if_fail(self != NULL);
 
-    if ( ( self->output.user_data != NULL ) && ( self->output.notify != NULL ) )
-        self->output.notify(self->output.user_data);
+    guint i;
+    for ( i = 0 ; i < self->outputs_size ; ++i )
+    {
+        J4statusSectionOutput *output = &self->outputs[i];
+        if ( ( output->user_data != NULL ) && ( output->notify != NULL ) )
+            output->notify(output->user_data);
+        g_free(output->cache);
+    }
+    g_free(self->outputs);
 
     if ( self->freeze )
         self->core->remove_section(self->core->context, self);
 
-    g_free(self->cache);
-
     g_free(self->short_value);
     g_free(self->value);
 
@@ -236,6 +284,13 @@ j4status_section_insert(J4statusSection *self)
     if ( ! _j4status_section_get_override(self) )
         return FALSE;
 
+    if ( self->label != NULL )
+    {
+        const gchar *cut = NULL;
+        gsize cut_width;
+        self->label_width = _j4status_section_display_width(self->label, 0, &cut, &cut_width);
+    }
+
     self->freeze = self->core->add_section(self->core->context, self);
     return self->freeze;
 }
@@ -247,10 +302,12 @@ j4status_section_set_state(J4statusSection *self, J4statusState state)
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
+    ++self->setter_calls;
+
     if ( state & J4STATUS_STATE_URGENT )
-        self->core->trigger_generate(self->core->context, TRUE);
+        self->core->update_section(self->core->context, self, TRUE);
     else if ( ! self->dirty )
-        self->core->trigger_generate(self->core->context, FALSE);
+        self->core->update_section(self->core->context, self, FALSE);
 
     self->dirty = TRUE;
 
@@ -263,8 +320,10 @@ j4status_section_set_colour(J4statusSection *self, J4statusColour colour)
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
+    ++self->setter_calls;
+
     if ( ! self->dirty )
-        self->core->trigger_generate(self->core->context, FALSE);
+        self->core->update_section(self->core->context, self, FALSE);
 
     self->dirty = TRUE;
 
@@ -277,30 +336,110 @@ j4status_section_set_background_colour(J4statusSection *self, J4statusColour col
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
+    ++self->setter_calls;
+
     if ( ! self->dirty )
-        self->core->trigger_generate(self->core->context, FALSE);
+        self->core->update_section(self->core->context, self, FALSE);
 
     self->dirty = TRUE;
 
     self->background_colour = colour;
 }
 
+static void
+_j4status_section_set_value(J4statusSection *self, gchar *value)
+{
+    if ( ( value != NULL ) && ( *value == '\0' ) )
+        value = (g_free(value), NULL);
+
+    /* Width and truncation are done once here, for all outputs */
+    gsize width = 0;
+    if ( value != NULL )
+    {
+        gsize max = self->truncate_width;
+        const gchar *cut = NULL;
+        gsize cut_width = 0;
+        width = _j4status_section_display_width(value, max, &cut, &cut_width);
+        if ( ( max > 0 ) && ( width > max ) )
+        {
+            gsize l = cut - value;
+            gchar *truncated = g_new(gchar, l + strlen(ELLIPSIS) + 1);
+            memcpy(truncated, value, l);
+            strcpy(truncated + l, ELLIPSIS);
+            g_free(value);
+            value = truncated;
+            width = cut_width + 1;
+        }
+    }
+
+    if ( g_strcmp0(self->value, value) == 0 )
+    {
+        g_free(value);
+        return;
+    }
+
+    if ( ! self->dirty )
+        self->core->update_section(self->core->context, self, FALSE);
+
+    self->dirty = TRUE;
+
+    g_free(self->value);
+    self->value = value;
+    self->value_size = ( value != NULL ) ? ( strlen(value) + 1 ) : 0;
+    self->value_width = width;
+}
+
 J4STATUS_EXPORT void
 j4status_section_set_value(J4statusSection *self, gchar *value)
 {
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
+    ++self->setter_calls;
+
+    _j4status_section_set_value(self, value);
+}
+
+/*
+ * For plugins rendering into their own buffer
+ * The value is copied in our current one when it fits, so that
+ * a value which keeps its length, like a clock, costs no allocation
+ */
+J4STATUS_EXPORT void
+j4status_section_set_value_copy(J4statusSection *self, const gchar *value)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(self->freeze);
+
+    ++self->setter_calls;
+
+    /* A truncated value has to go the long way */
+    if ( ( self->truncate_width > 0 ) || ( value == NULL ) || ( *value == '\0' ) || ( self->value == NULL ) )
+    {
+        _j4status_section_set_value(self, g_strdup(value));
+        return;
+    }
+
+    if ( strcmp(self->value, value) == 0 )
+        return;
+
+    gsize size = strlen(value) + 1;
+    if ( size > self->value_size )
+    {
+        _j4status_section_set_value(self, g_strdup(value));
+        return;
+    }
+
+    const gchar *cut = NULL;
+    gsize cut_width;
+
     if ( ! self->dirty )
-        self->core->trigger_generate(self->core->context, FALSE);
+        self->core->update_section(self->core->context, self, FALSE);
 
     self->dirty = TRUE;
 
-    if ( ( value != NULL ) && ( *value == '\0' ) )
-        value = (g_free(value), NULL);
-
-    g_free(self->value);
-    self->value = value;
+    memcpy(self->value, value, size);
+    self->value_width = _j4status_section_display_width(self->value, 0, &cut, &cut_width);
 }
 
 J4STATUS_EXPORT void
@@ -309,8 +448,10 @@ j4status_section_set_short_value(J4statusSection *self, gchar *short_value)
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
+    ++self->setter_calls;
+
     if ( ! self->dirty )
-        self->core->trigger_generate(self->core->context, FALSE);
+        self->core->update_section(self->core->context, self, FALSE);
 
     self->dirty = TRUE;
 
@@ -350,6 +491,15 @@ j4status_section_get_label(const J4statusSection *self)
     return self->label;
 }
 
+J4STATUS_EXPORT gsize
+j4status_section_get_label_width(const J4statusSection *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    g_return_val_if_fail(self->freeze, 0);
+
+    return self->label_width;
+}
+
 J4STATUS_EXPORT J4statusColour
 j4status_section_get_label_colour(const J4statusSection *self)
 {
@@ -415,6 +565,15 @@ j4status_section_get_value(const J4statusSection *self)
     return self->value;
 }
 
+J4STATUS_EXPORT gsize
+j4status_section_get_value_width(const J4statusSection *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    g_return_val_if_fail(self->freeze, 0);
+
+    return self->value_width;
+}
+
 J4STATUS_EXPORT const gchar *
 j4status_section_get_short_value(const J4statusSection *self)
 {
@@ -439,9 +598,9 @@ j4status_section_set_cache(J4statusSection *self, gchar *cache)
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
-    g_free(self->cache);
-    self->cache = cache;
-    self->dirty = FALSE;
+    J4statusSectionOutput *output = _j4status_section_get_output(self);
+    g_free(output->cache);
+    output->cache = cache;
 }
 
 J4STATUS_EXPORT const gchar *
@@ -450,7 +609,10 @@ j4status_section_get_cache(const J4statusSection *self)
     g_return_val_if_fail(self != NULL, NULL);
     g_return_val_if_fail(self->freeze, NULL);
 
-    return self->cache;
+    guint output = self->core->get_output(self->core->context);
+    if ( output >= self->outputs_size )
+        return NULL;
+    return self->outputs[output].cache;
 }
 
 J4STATUS_EXPORT void
@@ -459,8 +621,9 @@ j4status_section_set_output_user_data(J4statusSection *self, gpointer user_data,
     g_return_if_fail(self != NULL);
     g_return_if_fail(self->freeze);
 
-    self->output.user_data = user_data;
-    self->output.notify = notify;
+    J4statusSectionOutput *output = _j4status_section_get_output(self);
+    output->user_data = user_data;
+    output->notify = notify;
 }
 
 J4STATUS_EXPORT gpointer
@@ -469,5 +632,20 @@ j4status_section_get_output_user_data(J4statusSection *self)
     g_return_val_if_fail(self != NULL, NULL);
     g_return_val_if_fail(self->freeze, NULL);
 
-    return self->output.user_data;
+    guint output = self->core->get_output(self->core->context);
+    if ( output >= self->outputs_size )
+        return NULL;
+    return self->outputs[output].user_data;
+}
+
+J4STATUS_EXPORT void
+j4status_section_trigger_action(J4statusSection *self, const gchar *event_id)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(event_id != NULL);
+
+    if ( self->action.callback == NULL )
+        return;
+
+    self->action.callback(self, event_id, self->action.user_data);
 }
@@ -0,0 +1,75 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __J4STATUS_TEST_CORE_H__
+#define __J4STATUS_TEST_CORE_H__
+
+/*
+ * A core for tests and benchmarks driving a plugin directly:
+ * every section is accepted, updates are left to the caller
+ */
+
+#include "j4status-plugin-output.h"
+#include "j4status-plugin-input.h"
+#include "j4status-plugin-private.h"
+
+static gboolean
+_j4status_test_core_add_section(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED J4statusSection *section)
+{
+    return TRUE;
+}
+
+static void
+_j4status_test_core_remove_section(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED J4statusSection *section)
+{
+}
+
+static void
+_j4status_test_core_update_section(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED J4statusSection *section, G_GNUC_UNUSED gboolean force)
+{
+}
+
+static guint
+_j4status_test_core_get_output(G_GNUC_UNUSED J4statusCoreContext *context)
+{
+    return 0;
+}
+
+static void
+_j4status_test_core_set_tracing(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED gboolean tracing)
+{
+}
+
+static void
+j4status_test_core_init(J4statusCoreInterface *core)
+{
+    J4statusCoreInterface test_core = {
+        .add_section = _j4status_test_core_add_section,
+        .remove_section = _j4status_test_core_remove_section,
+        .update_section = _j4status_test_core_update_section,
+        .get_output = _j4status_test_core_get_output,
+        .set_tracing = _j4status_test_core_set_tracing,
+    };
+    *core = test_core;
+}
+
+#endif /* __J4STATUS_TEST_CORE_H__ */
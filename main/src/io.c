@@ -32,6 +32,7 @@
 #include <gio/gunixsocketaddress.h>
 #include <gio/gunixoutputstream.h>
 #include <gio/gunixinputstream.h>
+#include <unistd.h>
 #endif /* G_OS_UNIX */
 
 #ifdef ENABLE_SYSTEMD
@@ -45,6 +46,7 @@
 #include "j4status-plugin-input.h"
 #include "j4status-plugin-private.h"
 #include "plugins.h"
+#include "stats.h"
 
 #include "io.h"
 
@@ -52,29 +54,187 @@ struct _J4statusIOContext {
     J4statusCoreContext *core;
     J4statusOutputPlugin *plugin;
     GSocketService *server;
-    GList *streams;
+    GQueue streams;
     GList *paths_to_unlink;
+    GPtrArray *frame;
+    guint clients;
+    guint max_clients;
+    gint64 client_timeout;
+    guint64 serial;
+    struct {
+        guint64 accepted;
+        guint64 rejected;
+        guint64 evicted;
+        guint64 frames;
+        guint64 dropped;
+        guint64 queued;
+        guint64 written;
+        guint64 errors;
+        guint64 reconnects;
+        J4statusStatsHistogram write_time;
+    } stats;
 };
 
 struct _J4statusIOStream {
     J4statusIOContext *io;
+    GList link;
+    guint64 id;
+    gboolean accepted;
     guint tries;
     GSocketAddress *address;
     GSocketConnection *connection;
     GInputStream *in;
     GOutputStream *out;
+    GOutputStream *buffer;
+    J4statusIOWrite *write;
+    gint64 write_start;
+    gboolean line_pending;
     J4statusOutputPluginStream *stream;
     gboolean header_sent;
+    struct {
+        guint64 frames;
+        guint64 dropped;
+        guint64 queued;
+        guint64 written;
+        guint64 errors;
+        guint64 reconnects;
+    } stats;
+};
+
+/*
+ * Plugins render into the stream buffer, which we write asynchronously.
+ * While a write is in flight, new lines are not rendered: we only remember
+ * one is pending, and render the latest one when the writer is free again.
+ *
+ * Plugins implementing get_line give us the line once for all streams,
+ * as a list of immutable chunks that every stream writes from directly.
+ */
+struct _J4statusIOWrite {
+    J4statusIOStream *stream;
+    GPtrArray *chunks;
+    gsize size;
+    GCancellable *cancellable;
+#if GLIB_CHECK_VERSION(2,60,0)
+    GOutputVector *vectors;
+#else /* ! GLIB_CHECK_VERSION(2,60,0) */
+    guint index;
+    gsize offset;
+#endif /* ! GLIB_CHECK_VERSION(2,60,0) */
 };
 
 #define MAX_TRIES 3
+#define FLUSH_TIMEOUT 1
+#define SERVER_BACKLOG 128
 
 static void _j4status_io_stream_connect_callback(GObject *obj, GAsyncResult *res, gpointer user_data);
 static void _j4status_io_stream_put_header(J4statusIOStream *stream);
+static void _j4status_io_stream_put_line(J4statusIOStream *stream);
+static void _j4status_io_stream_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data);
+
+static void
+_j4status_io_write_free(J4statusIOWrite *write)
+{
+#if GLIB_CHECK_VERSION(2,60,0)
+    g_free(write->vectors);
+#endif /* GLIB_CHECK_VERSION(2,60,0) */
+    g_object_unref(write->cancellable);
+    g_ptr_array_unref(write->chunks);
+    g_slice_free(J4statusIOWrite, write);
+}
+
+static void
+_j4status_io_stream_write(J4statusIOStream *self)
+{
+    J4statusIOWrite *write = self->write;
+
+#if GLIB_CHECK_VERSION(2,60,0)
+    g_output_stream_writev_all_async(self->out, write->vectors, write->chunks->len, G_PRIORITY_DEFAULT, write->cancellable, _j4status_io_stream_write_callback, write);
+#else /* ! GLIB_CHECK_VERSION(2,60,0) */
+    const guint8 *data;
+    gsize size;
+    data = g_bytes_get_data(g_ptr_array_index(write->chunks, write->index), &size);
+
+    g_output_stream_write_async(self->out, data + write->offset, size - write->offset, G_PRIORITY_DEFAULT, write->cancellable, _j4status_io_stream_write_callback, write);
+#endif /* ! GLIB_CHECK_VERSION(2,60,0) */
+}
+
+/* Takes ownership of chunks */
+static void
+_j4status_io_stream_send(J4statusIOStream *self, GPtrArray *chunks)
+{
+    J4statusIOWrite *write;
+    write = g_slice_new0(J4statusIOWrite);
+    write->stream = self;
+    write->chunks = chunks;
+    write->cancellable = g_cancellable_new();
+
+#if GLIB_CHECK_VERSION(2,60,0)
+    write->vectors = g_new(GOutputVector, chunks->len);
+#endif /* GLIB_CHECK_VERSION(2,60,0) */
+
+    gsize size = 0;
+    guint i;
+    for ( i = 0 ; i < chunks->len ; ++i )
+    {
+        GBytes *chunk = g_ptr_array_index(chunks, i);
+#if GLIB_CHECK_VERSION(2,60,0)
+        write->vectors[i].buffer = g_bytes_get_data(chunk, &write->vectors[i].size);
+#endif /* GLIB_CHECK_VERSION(2,60,0) */
+        size += g_bytes_get_size(chunk);
+    }
+    if ( size == 0 )
+    {
+        _j4status_io_write_free(write);
+        return;
+    }
+
+    write->size = size;
+    ++self->stats.frames;
+    self->stats.queued += size;
+    self->write_start = g_get_monotonic_time();
+
+#if ! GLIB_CHECK_VERSION(2,60,0)
+    while ( g_bytes_get_size(g_ptr_array_index(chunks, write->index)) == 0 )
+        ++write->index;
+#endif /* ! GLIB_CHECK_VERSION(2,60,0) */
+
+    self->write = write;
+    _j4status_io_stream_write(self);
+}
+
+static void
+_j4status_io_stream_flush(J4statusIOStream *self)
+{
+    gsize size;
+    size = g_seekable_tell(G_SEEKABLE(self->buffer));
+    if ( size == 0 )
+        return;
+
+    GPtrArray *chunks;
+    chunks = g_ptr_array_new_with_free_func((GDestroyNotify) g_bytes_unref);
+    g_ptr_array_add(chunks, g_bytes_new_with_free_func(g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(self->buffer)), size, g_object_unref, g_object_ref(self->buffer)));
+
+    _j4status_io_stream_send(self, chunks);
+}
 
 static void
 _j4status_io_stream_cleanup(J4statusIOStream *self)
 {
+    if ( self->write != NULL )
+    {
+        /* The callback will free it */
+        self->write->stream = NULL;
+        g_cancellable_cancel(self->write->cancellable);
+        self->write = NULL;
+    }
+    self->line_pending = FALSE;
+
+    if ( self->buffer != NULL )
+    {
+        g_object_unref(self->buffer);
+        self->buffer = NULL;
+    }
+
     if ( self->in != NULL )
     {
         g_object_unref(self->in);
@@ -102,6 +262,7 @@ _j4status_io_stream_set_connection(J4statusIOStream *self, GSocketConnection *co
     self->connection = connection;
     self->in = g_object_ref(g_io_stream_get_input_stream(G_IO_STREAM(self->connection)));
     self->out = g_object_ref(g_io_stream_get_output_stream(G_IO_STREAM(self->connection)));
+    self->buffer = g_memory_output_stream_new_resizable();
     self->stream = self->io->plugin->interface.stream_new(self->io->plugin->context, self);
     if ( ! self->header_sent )
         _j4status_io_stream_put_header(self);
@@ -128,7 +289,17 @@ j4status_io_stream_get_input_stream(J4statusIOStream *self)
 GOutputStream *
 j4status_io_stream_get_output_stream(J4statusIOStream *self)
 {
-    return self->out;
+    return self->buffer;
+}
+
+gboolean
+j4status_io_stream_is_terminal(J4statusIOStream *self)
+{
+#ifdef G_OS_UNIX
+    if ( G_IS_UNIX_OUTPUT_STREAM(self->out) )
+        return isatty(g_unix_output_stream_get_fd(G_UNIX_OUTPUT_STREAM(self->out)));
+#endif /* G_OS_UNIX */
+    return FALSE;
 }
 
 void
@@ -139,8 +310,11 @@ j4status_io_stream_reconnect(J4statusIOStream *self)
         return;
 
     if ( self->address != NULL )
+    {
         /* Client stream */
+        ++self->stats.reconnects;
         _j4status_io_stream_connect(self);
+    }
     else
         /* Server stream */
         j4status_io_stream_free(self);
@@ -162,7 +336,10 @@ _j4status_io_stream_connect_callback(GObject *obj, GAsyncResult *res, gpointer u
         if ( ++self->tries > MAX_TRIES )
             j4status_io_stream_free(self);
         else
+        {
+            ++self->stats.reconnects;
             _j4status_io_stream_connect(self);
+        }
     }
     else
         _j4status_io_stream_set_connection(self, connection);
@@ -174,6 +351,8 @@ _j4status_io_stream_new(J4statusIOContext *io)
     J4statusIOStream *self;
     self = g_slice_new0(J4statusIOStream);
     self->io = io;
+    self->link.data = self;
+    self->id = ++io->serial;
 
     return self;
 }
@@ -206,6 +385,7 @@ _j4status_io_stream_add(J4statusIOContext *self, const gchar *stream_desc)
 
         stream->out = out;
         stream->in = in;
+        stream->buffer = g_memory_output_stream_new_resizable();
 
         stream->stream = stream->io->plugin->interface.stream_new(stream->io->plugin->context, stream);
 
@@ -256,7 +436,7 @@ _j4status_io_stream_add(J4statusIOContext *self, const gchar *stream_desc)
     _j4status_io_stream_connect(stream);
 
 end:
-    self->streams = g_list_prepend(self->streams, stream);
+    g_queue_push_tail_link(&self->streams, &stream->link);
 }
 
 static void
@@ -271,9 +451,36 @@ _j4status_io_stream_free(gpointer data)
     if ( self->address != NULL )
         g_object_unref(self->address);
 
+    g_debug("Stream closed: %" G_GUINT64_FORMAT " frames (%" G_GUINT64_FORMAT " dropped), %" G_GUINT64_FORMAT " bytes queued, %" G_GUINT64_FORMAT " bytes written", self->stats.frames, self->stats.dropped, self->stats.queued, self->stats.written);
+
+    J4statusIOContext *io = self->io;
+    if ( self->accepted )
+        --io->clients;
+    io->stats.frames += self->stats.frames;
+    io->stats.dropped += self->stats.dropped;
+    io->stats.queued += self->stats.queued;
+    io->stats.written += self->stats.written;
+    io->stats.errors += self->stats.errors;
+    io->stats.reconnects += self->stats.reconnects;
+
     g_slice_free(J4statusIOStream, self);
 }
 
+static void
+_j4status_io_stream_write_error(J4statusIOStream *self, GError *error)
+{
+    /*
+     * We do not output on broken pipe
+     * because this is what we get on disconnect.
+     * Too frequent to warrant a warning.
+     */
+    ++self->stats.errors;
+    if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) )
+        g_warning("Couldn't write line: %s", error->message);
+
+    j4status_io_stream_reconnect(self);
+}
+
 static gboolean
 _j4status_io_stream_put_string(J4statusIOStream *self, J4statusPluginSendFunc send_func)
 {
@@ -283,21 +490,80 @@ _j4status_io_stream_put_string(J4statusIOStream *self, J4statusPluginSendFunc se
         return FALSE;
 
     GError *error = NULL;
-    if ( send_func(self->io->plugin->context, self->stream, &error) )
-        return TRUE;
+    if ( ! send_func(self->io->plugin->context, self->stream, &error) )
+    {
+        _j4status_io_stream_write_error(self, error);
+        g_clear_error(&error);
+        return FALSE;
+    }
 
-    /*
-     * We do not output on broken pipe
-     * because this is what we get on disconnect.
-     * Too frequent to warrant a warning.
-     */
-    if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) )
-        g_warning("Couldn't write line: %s", error->message);
-    g_clear_error(&error);
+    _j4status_io_stream_flush(self);
 
-    j4status_io_stream_reconnect(self);
+    return TRUE;
+}
 
-    return FALSE;
+static void
+_j4status_io_stream_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    J4statusIOWrite *write = user_data;
+    J4statusIOStream *self = write->stream;
+
+    GError *error = NULL;
+#if GLIB_CHECK_VERSION(2,60,0)
+    gsize written = 0;
+    gboolean r;
+    r = g_output_stream_writev_all_finish(G_OUTPUT_STREAM(obj), res, &written, &error);
+#else /* ! GLIB_CHECK_VERSION(2,60,0) */
+    gssize written;
+    gboolean r;
+    written = g_output_stream_write_finish(G_OUTPUT_STREAM(obj), res, &error);
+    r = ( written >= 0 );
+#endif /* ! GLIB_CHECK_VERSION(2,60,0) */
+
+    if ( self == NULL )
+    {
+        /* Stream went away in the meantime */
+        g_clear_error(&error);
+        _j4status_io_write_free(write);
+        return;
+    }
+
+    if ( ! r )
+    {
+        self->write = NULL;
+        _j4status_io_write_free(write);
+        _j4status_io_stream_write_error(self, error);
+        g_clear_error(&error);
+        return;
+    }
+
+    self->stats.written += written;
+#if ! GLIB_CHECK_VERSION(2,60,0)
+    write->offset += written;
+    while ( ( write->index < write->chunks->len ) && ( write->offset >= g_bytes_get_size(g_ptr_array_index(write->chunks, write->index)) ) )
+    {
+        ++write->index;
+        write->offset = 0;
+    }
+    if ( write->index < write->chunks->len )
+    {
+        _j4status_io_stream_write(self);
+        return;
+    }
+#endif /* ! GLIB_CHECK_VERSION(2,60,0) */
+
+    j4status_stats_histogram_add(&self->io->stats.write_time, g_get_monotonic_time() - self->write_start);
+    j4status_core_trace_write(self->io->core, self->io, self->id, self->write_start, write->size);
+
+    self->write = NULL;
+    _j4status_io_write_free(write);
+    g_seekable_seek(G_SEEKABLE(self->buffer), 0, G_SEEK_SET, NULL, NULL);
+
+    if ( self->line_pending )
+    {
+        self->line_pending = FALSE;
+        _j4status_io_stream_put_line(self);
+    }
 }
 
 static void
@@ -309,7 +575,30 @@ _j4status_io_stream_put_header(J4statusIOStream *self)
 static void
 _j4status_io_stream_put_line(J4statusIOStream *self)
 {
-    if ( self->header_sent )
+    if ( ! self->header_sent )
+        return;
+
+    if ( self->write != NULL )
+    {
+        if ( self->accepted && ( self->io->client_timeout > 0 ) && ( ( g_get_monotonic_time() - self->write_start ) > self->io->client_timeout ) )
+        {
+            /* This client is not reading, do not keep it around */
+            g_debug("Evicting slow client");
+            ++self->io->stats.evicted;
+            j4status_io_stream_free(self);
+            return;
+        }
+
+        /* Latest frame wins */
+        if ( self->line_pending )
+            ++self->stats.dropped;
+        self->line_pending = TRUE;
+        return;
+    }
+
+    if ( self->io->frame != NULL )
+        _j4status_io_stream_send(self, g_ptr_array_ref(self->io->frame));
+    else
         _j4status_io_stream_put_string(self, self->io->plugin->interface.send_line);
 }
 
@@ -319,9 +608,23 @@ _j4status_io_server_callback(GSocketService *service, GSocketConnection *connect
     J4statusIOContext *self = user_data;
     J4statusIOStream *stream;
 
+    if ( ( self->max_clients > 0 ) && ( self->clients >= self->max_clients ) )
+    {
+        g_debug("Rejecting client: %u clients connected", self->clients);
+        ++self->stats.rejected;
+        g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+        return FALSE;
+    }
+
     stream = _j4status_io_stream_new_for_connection(self, connection);
-    self->streams = g_list_prepend(self->streams, stream);
-    _j4status_io_stream_put_line(stream);
+    stream->accepted = TRUE;
+    ++self->clients;
+    ++self->stats.accepted;
+    g_queue_push_tail_link(&self->streams, &stream->link);
+
+    /* If we were idle, a fresh line is on its way */
+    if ( ! j4status_core_stream_added(self->core) )
+        _j4status_io_stream_put_line(stream);
 
     return FALSE;
 }
@@ -334,6 +637,7 @@ _j4status_io_add_server(J4statusIOContext *self)
         return FALSE;
 
     self->server = g_socket_service_new();
+    g_socket_listener_set_backlog(G_SOCKET_LISTENER(self->server), SERVER_BACKLOG);
     g_signal_connect(self->server, "incoming", (GCallback) _j4status_io_server_callback, self);
 
     return TRUE;
@@ -397,11 +701,11 @@ _j4status_io_add_systemd(J4statusIOContext *self)
 #endif /* ENABLE_SYSTEMD */
 }
 
-static void
-_j4status_io_server_add(J4statusIOContext *self, const gchar *server_desc)
+gboolean
+j4status_io_listener_add(GSocketListener *listener, const gchar *server_desc, gchar **path)
 {
     GSocketAddress *address = NULL;
-    const gchar *path = NULL;
+    const gchar *unix_path = NULL;
 
     if ( g_str_has_prefix(server_desc, "tcp:") )
     {
@@ -426,7 +730,7 @@ _j4status_io_server_add(J4statusIOContext *self, const gchar *server_desc)
         guint64 port;
         port = g_ascii_strtoull(port_str, NULL, 10);
         if ( port > 65535 )
-            return;
+            return FALSE;
 
 
         address = g_inet_socket_address_new(inet_address, port);
@@ -435,32 +739,44 @@ _j4status_io_server_add(J4statusIOContext *self, const gchar *server_desc)
 #ifdef G_OS_UNIX
     if ( g_str_has_prefix(server_desc, "unix:") )
     {
-        path = server_desc + strlen("unix:");
+        unix_path = server_desc + strlen("unix:");
 
-        address = g_unix_socket_address_new(path);
+        address = g_unix_socket_address_new(unix_path);
     }
 #endif /* G_OS_UNIX */
 
     if ( address == NULL )
-        return;
-
-    gboolean need_free_server = _j4status_io_add_server(self);
+        return FALSE;
 
     GError *error = NULL;
     gboolean r;
-    r = g_socket_listener_add_address(G_SOCKET_LISTENER(self->server), address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+    r = g_socket_listener_add_address(listener, address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
     g_object_unref(address);
 
-    if ( r )
+    if ( ! r )
+    {
+        g_warning("Couldn't add listener for '%s': %s", server_desc, error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    *path = g_strdup(unix_path);
+    return TRUE;
+}
+
+static void
+_j4status_io_server_add(J4statusIOContext *self, const gchar *server_desc)
+{
+    gboolean need_free_server = _j4status_io_add_server(self);
+
+    gchar *path;
+    if ( j4status_io_listener_add(G_SOCKET_LISTENER(self->server), server_desc, &path) )
     {
         if ( path != NULL )
-            self->paths_to_unlink = g_list_prepend(self->paths_to_unlink, g_strdup(path));
+            self->paths_to_unlink = g_list_prepend(self->paths_to_unlink, path);
         return;
     }
 
-    g_warning("Couldn't add listener for '%s': %s", server_desc, error->message);
-    g_clear_error(&error);
-
     if ( need_free_server )
     {
         g_object_unref(self->server);
@@ -468,30 +784,37 @@ _j4status_io_server_add(J4statusIOContext *self, const gchar *server_desc)
     }
 }
 
-static inline gboolean
-_j4status_io_has_stream(J4statusIOContext *self)
+gboolean
+j4status_io_has_subscribers(J4statusIOContext *self)
 {
-    return ( ( self->streams != NULL ) || ( self->server != NULL ) );
+    return ( self->streams.length > 0 );
+}
+
+gboolean
+j4status_io_has_stream(J4statusIOContext *self)
+{
+    return ( ( self->streams.length > 0 ) || ( self->server != NULL ) );
 }
 
 J4statusIOContext *
-j4status_io_new(J4statusCoreContext *core, J4statusOutputPlugin *plugin, const gchar * const *servers_desc, const gchar * const *streams_desc)
+j4status_io_new(J4statusCoreContext *core, J4statusOutputPlugin *plugin, const gchar * const *servers_desc, const gchar * const *streams_desc, gboolean default_streams)
 {
     J4statusIOContext *self;
     self = g_new0(J4statusIOContext, 1);
     self->core = core;
     self->plugin = plugin;
 
-    _j4status_io_add_systemd(self);
+    if ( default_streams )
+        _j4status_io_add_systemd(self);
 
-    if ( ( servers_desc == NULL ) && ( streams_desc == NULL ) && ( ! _j4status_io_has_stream(self) ) )
+    if ( default_streams && ( servers_desc == NULL ) && ( streams_desc == NULL ) && ( ! j4status_io_has_stream(self) ) )
         /* Using stdin/stdout */
         _j4status_io_stream_add(self, "std");
 
     if ( servers_desc != NULL )
     {
         const gchar * const *server_desc;
-        for ( server_desc = servers_desc ; *servers_desc != NULL ; ++servers_desc)
+        for ( server_desc = servers_desc ; *server_desc != NULL ; ++server_desc)
             _j4status_io_server_add(self, *server_desc);
     }
 
@@ -502,13 +825,75 @@ j4status_io_new(J4statusCoreContext *core, J4statusOutputPlugin *plugin, const g
             _j4status_io_stream_add(self, *stream_desc);
     }
 
-    if ( _j4status_io_has_stream(self) )
+    if ( j4status_io_has_stream(self) )
         return self;
 
     j4status_io_free(self);
     return NULL;
 }
 
+void
+j4status_io_set_limits(J4statusIOContext *self, guint max_clients, gint64 client_timeout)
+{
+    self->max_clients = max_clients;
+    self->client_timeout = client_timeout;
+}
+
+void
+j4status_io_dump_stats(J4statusIOContext *self, GKeyFile *stats, const gchar *group)
+{
+    guint64 frames = self->stats.frames;
+    guint64 dropped = self->stats.dropped;
+    guint64 queued = self->stats.queued;
+    guint64 written = self->stats.written;
+    guint64 errors = self->stats.errors;
+    guint64 reconnects = self->stats.reconnects;
+
+    GList *stream_;
+    for ( stream_ = self->streams.head ; stream_ != NULL ; stream_ = g_list_next(stream_) )
+    {
+        J4statusIOStream *stream = stream_->data;
+        frames += stream->stats.frames;
+        dropped += stream->stats.dropped;
+        queued += stream->stats.queued;
+        written += stream->stats.written;
+        errors += stream->stats.errors;
+        reconnects += stream->stats.reconnects;
+
+        const gchar *kind = "std";
+        if ( stream->accepted )
+            kind = "accepted";
+        else if ( stream->address != NULL )
+            kind = "connected";
+
+        gchar *stream_group;
+        stream_group = g_strdup_printf("%s stream %" G_GUINT64_FORMAT, group, stream->id);
+        g_key_file_set_string(stats, stream_group, "Kind", kind);
+        g_key_file_set_boolean(stats, stream_group, "Writing", ( stream->write != NULL ));
+        g_key_file_set_uint64(stats, stream_group, "Frames", stream->stats.frames);
+        g_key_file_set_uint64(stats, stream_group, "DroppedFrames", stream->stats.dropped);
+        g_key_file_set_uint64(stats, stream_group, "BytesQueued", stream->stats.queued);
+        g_key_file_set_uint64(stats, stream_group, "BytesWritten", stream->stats.written);
+        g_key_file_set_uint64(stats, stream_group, "Errors", stream->stats.errors);
+        g_key_file_set_uint64(stats, stream_group, "Reconnects", stream->stats.reconnects);
+        g_free(stream_group);
+    }
+
+    g_key_file_set_uint64(stats, group, "Streams", self->streams.length);
+    g_key_file_set_uint64(stats, group, "Clients", self->clients);
+    g_key_file_set_uint64(stats, group, "MaxClients", self->max_clients);
+    g_key_file_set_uint64(stats, group, "AcceptedClients", self->stats.accepted);
+    g_key_file_set_uint64(stats, group, "RejectedClients", self->stats.rejected);
+    g_key_file_set_uint64(stats, group, "EvictedClients", self->stats.evicted);
+    g_key_file_set_uint64(stats, group, "Frames", frames);
+    g_key_file_set_uint64(stats, group, "DroppedFrames", dropped);
+    g_key_file_set_uint64(stats, group, "BytesQueued", queued);
+    g_key_file_set_uint64(stats, group, "BytesWritten", written);
+    g_key_file_set_uint64(stats, group, "Errors", errors);
+    g_key_file_set_uint64(stats, group, "Reconnects", reconnects);
+    j4status_stats_histogram_dump(&self->stats.write_time, stats, group, "WriteTime");
+}
+
 static void
 _j4status_io_unlink_path(gpointer data)
 {
@@ -517,15 +902,53 @@ _j4status_io_unlink_path(gpointer data)
     g_free(path);
 }
 
+static gboolean
+_j4status_io_is_writing(J4statusIOContext *self)
+{
+    GList *stream_;
+    for ( stream_ = self->streams.head ; stream_ != NULL ; stream_ = g_list_next(stream_) )
+    {
+        J4statusIOStream *stream = stream_->data;
+        if ( stream->write != NULL )
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+_j4status_io_flush_timeout(gpointer user_data)
+{
+    gboolean *timed_out = user_data;
+    *timed_out = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/* Give pending writes a chance to complete, e.g. in one-shot mode */
+void
+j4status_io_flush(J4statusIOContext *self)
+{
+    gboolean timed_out = FALSE;
+    guint timeout = g_timeout_add_seconds(FLUSH_TIMEOUT, _j4status_io_flush_timeout, &timed_out);
+    while ( ( ! timed_out ) && _j4status_io_is_writing(self) )
+        g_main_context_iteration(NULL, TRUE);
+    if ( ! timed_out )
+        g_source_remove(timeout);
+}
+
 void
 j4status_io_free(J4statusIOContext *self)
 {
-    g_list_free_full(self->streams, _j4status_io_stream_free);
+    GList *stream;
+    while ( ( stream = g_queue_pop_head_link(&self->streams) ) != NULL )
+        _j4status_io_stream_free(stream->data);
     g_list_free_full(self->paths_to_unlink, _j4status_io_unlink_path);
 
     if ( self->server != NULL )
         g_object_unref(self->server);
 
+    if ( self->frame != NULL )
+        g_ptr_array_unref(self->frame);
+
     g_free(self);
 }
 
@@ -533,16 +956,29 @@ void
 j4status_io_stream_free(J4statusIOStream *self)
 {
     J4statusIOContext *io = self->io;
-    io->streams = g_list_remove(io->streams, self);
+    g_queue_unlink(&io->streams, &self->link);
     _j4status_io_stream_free(self);
-    if ( ! _j4status_io_has_stream(io) )
-        j4status_core_quit(io->core);
+    j4status_core_stream_removed(io->core);
 }
 
 void
 j4status_io_update_line(J4statusIOContext *self)
 {
-    GList *stream = self->streams;
+    if ( self->frame != NULL )
+        g_ptr_array_unref(self->frame);
+    self->frame = NULL;
+
+    if ( self->plugin->interface.get_line != NULL )
+    {
+        self->frame = g_ptr_array_new_with_free_func((GDestroyNotify) g_bytes_unref);
+        if ( ! self->plugin->interface.get_line(self->plugin->context, self->frame) )
+        {
+            g_ptr_array_unref(self->frame);
+            self->frame = NULL;
+        }
+    }
+
+    GList *stream = self->streams.head;
     while ( stream != NULL )
     {
         GList *next = g_list_next(stream);
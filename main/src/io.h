@@ -25,13 +25,20 @@
 
 #include "types.h"
 
-J4statusIOContext *j4status_io_new(J4statusCoreContext *core, J4statusOutputPlugin *plugin, const gchar * const *servers_desc, const gchar * const *streams_desc);
+J4statusIOContext *j4status_io_new(J4statusCoreContext *core, J4statusOutputPlugin *plugin, const gchar * const *servers_desc, const gchar * const *streams_desc, gboolean default_streams);
 void j4status_io_free(J4statusIOContext *io);
+void j4status_io_flush(J4statusIOContext *io);
+gboolean j4status_io_has_stream(J4statusIOContext *io);
+gboolean j4status_io_has_subscribers(J4statusIOContext *io);
+void j4status_io_set_limits(J4statusIOContext *io, guint max_clients, gint64 client_timeout);
+void j4status_io_dump_stats(J4statusIOContext *io, GKeyFile *stats, const gchar *group);
+gboolean j4status_io_listener_add(GSocketListener *listener, const gchar *server_desc, gchar **path);
 
 void j4status_io_update_line(J4statusIOContext *io);
 GInputStream *j4status_io_stream_get_input_stream(J4statusIOStream *stream);
 GOutputStream *j4status_io_stream_get_output_stream(J4statusIOStream *stream);
 void j4status_io_stream_reconnect(J4statusIOStream *stream);
+gboolean j4status_io_stream_is_terminal(J4statusIOStream *stream);
 void j4status_io_stream_free(J4statusIOStream *stream);
 
 #endif /* __J4STATUS_IO_H__ */
@@ -42,21 +42,53 @@
 
 #include "plugins.h"
 #include "io.h"
+#include "sections.h"
+#include "stats.h"
 
 #include "j4status.h"
 
+#define J4STATUS_CORE_DEFAULT_FRAME_INTERVAL 100
+#define J4STATUS_CORE_DEFAULT_CLIENT_TIMEOUT 30000
+#define J4STATUS_CORE_DEFAULT_IDLE_GRACE_PERIOD 5000
+
+typedef struct {
+    gchar *name;
+    J4statusOutputPlugin *plugin;
+    J4statusIOContext *io;
+    J4statusStatsHistogram generate_time;
+} J4statusCoreOutput;
+
 struct _J4statusCoreContext {
     guint interval;
     GMainLoop *loop;
     GList *input_plugins;
     GHashTable *order_weights;
-    GList *sections;
+    J4statusSections *sections;
     GHashTable *sections_hash;
-    J4statusOutputPlugin *output_plugin;
+    GPtrArray *dirty_sections;
+    gboolean sections_changed;
+    GArray *outputs;
+    guint current_output;
+    J4statusStats *stats;
+    gboolean tracing;
     gboolean started;
+    gboolean stopped;
+    gboolean idle;
+    gint64 idle_grace_period;
+    guint idle_handle;
     gulong display_handle;
     gboolean should_display;
-    J4statusIOContext *io;
+    struct {
+        gint64 interval;
+        gint64 max_latency;
+        gint64 last;
+        gboolean urgent;
+        guint updates;
+        guint64 count;
+        guint64 merged;
+        guint64 requests;
+        guint64 forced;
+    } frame;
 };
 
 #ifdef J4STATUS_DEBUG_OUTPUT
@@ -121,11 +153,49 @@ _j4status_core_debug_log_handler(const gchar *log_domain, GLogLevelFlags log_lev
 
 #endif /* ! J4STATUS_DEBUG_OUTPUT */
 
-static gint
-_j4status_core_compare_sections(gconstpointer a_, gconstpointer b_)
+/* Tracing is off unless an output plugin asks for it at init */
+static void
+_j4status_core_set_tracing(J4statusCoreContext *context, gboolean tracing)
+{
+    context->tracing = tracing;
+}
+
+static void
+_j4status_core_trace(J4statusCoreContext *context, const J4statusTraceEvent *event)
+{
+    guint i;
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+    {
+        J4statusOutputPlugin *plugin = g_array_index(context->outputs, J4statusCoreOutput, i).plugin;
+        if ( plugin->interface.trace != NULL )
+            plugin->interface.trace(plugin->context, event);
+    }
+}
+
+void
+j4status_core_trace_write(J4statusCoreContext *context, J4statusIOContext *io, guint64 stream, gint64 start, gsize size)
 {
-    const J4statusSection *a = a_, *b = b_;
-    return (a->weight - b->weight);
+    if ( ! context->tracing )
+        return;
+
+    const gchar *name = NULL;
+    guint i;
+    for ( i = 0 ; ( name == NULL ) && ( i < context->outputs->len ) ; ++i )
+    {
+        J4statusCoreOutput *output = &g_array_index(context->outputs, J4statusCoreOutput, i);
+        if ( output->io == io )
+            name = output->name;
+    }
+
+    J4statusTraceEvent event = {
+        .type = J4STATUS_TRACE_STREAM_WRITE,
+        .name = name,
+        .stream = stream,
+        .start = start,
+        .duration = g_get_monotonic_time() - start,
+        .size = size,
+    };
+    _j4status_core_trace(context, &event);
 }
 
 static gboolean
@@ -142,24 +212,23 @@ _j4status_core_add_section(J4statusCoreContext *context, J4statusSection *sectio
         if ( section->weight == 0 )
             section->weight = GPOINTER_TO_INT(g_hash_table_lookup(context->order_weights, section->name));
     }
-    if ( context->loop == NULL )
-    {
-        /* We are not started, thus sort has yet to happen */
-        context->sections = g_list_prepend(context->sections, section);
-        section->link = context->sections;
-    }
-    else
-    {
-        context->sections = g_list_insert_sorted(context->sections, section, _j4status_core_compare_sections);
-        section->link = g_list_find(context->sections, section);
-    }
+    j4status_sections_add(context->sections, section);
+    context->sections_changed = TRUE;
     return TRUE;
 }
 
 void
 _j4status_core_remove_section(J4statusCoreContext *context, J4statusSection *section)
 {
-    context->sections = g_list_remove_link(context->sections, section->link);
+    if ( section->dirty )
+        g_ptr_array_remove_fast(context->dirty_sections, section);
+
+    J4statusInputPlugin *plugin = section->core->plugin;
+    if ( plugin != NULL )
+        plugin->stats.setter_calls += section->setter_calls;
+
+    j4status_sections_remove(context->sections, section);
+    context->sections_changed = TRUE;
     g_hash_table_remove(context->sections_hash, section->id);
 }
 
@@ -171,22 +240,142 @@ _j4status_core_generate(gpointer user_data)
     context->display_handle = 0;
     context->should_display = FALSE;
 
-    context->output_plugin->interface.generate_line(context->output_plugin->context, context->sections);
-    j4status_io_update_line(context->io);
+    context->frame.last = g_get_monotonic_time();
+    context->frame.urgent = FALSE;
+    ++context->frame.count;
+    if ( context->frame.updates > 1 )
+    {
+        context->frame.merged += context->frame.updates - 1;
+        g_debug("Frame %" G_GUINT64_FORMAT ": merged %u updates (%" G_GUINT64_FORMAT " merged in total)", context->frame.count, context->frame.updates, context->frame.merged);
+    }
+    context->frame.updates = 0;
+
+    J4statusSection * const *sections;
+    gsize length;
+    sections = j4status_sections_get_array(context->sections, &length);
+
+    guint i;
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+    {
+        J4statusCoreOutput *output = &g_array_index(context->outputs, J4statusCoreOutput, i);
+        J4statusOutputPlugin *plugin = output->plugin;
+
+        /* Section caches are per-output, see _j4status_core_get_output() */
+        context->current_output = i;
+
+        gint64 start = g_get_monotonic_time();
+
+        /* The incremental path is only valid if no section was added or removed */
+        if ( ( plugin->interface.generate_line_incremental != NULL ) && ( ! context->sections_changed ) )
+            plugin->interface.generate_line_incremental(plugin->context, sections, length, (J4statusSection * const *) context->dirty_sections->pdata, context->dirty_sections->len);
+        else if ( plugin->interface.generate_line_array != NULL )
+            plugin->interface.generate_line_array(plugin->context, sections, length);
+        else
+            plugin->interface.generate_line(plugin->context, j4status_sections_get_list(context->sections));
+        j4status_io_update_line(output->io);
+
+        gint64 duration = g_get_monotonic_time() - start;
+        j4status_stats_histogram_add(&output->generate_time, duration);
+
+        if ( context->tracing )
+        {
+            J4statusTraceEvent event = {
+                .type = J4STATUS_TRACE_GENERATE,
+                .name = output->name,
+                .start = start,
+                .duration = duration,
+            };
+            _j4status_core_trace(context, &event);
+        }
+    }
+    /* Outside of a frame, we are back to the first output, like at startup */
+    context->current_output = 0;
+
+    for ( i = 0 ; i < context->dirty_sections->len ; ++i )
+        ((J4statusSection *) g_ptr_array_index(context->dirty_sections, i))->dirty = FALSE;
+    g_ptr_array_set_size(context->dirty_sections, 0);
+    context->sections_changed = FALSE;
 
     return G_SOURCE_REMOVE;
 }
 
+static void
+_j4status_core_schedule_generate(J4statusCoreContext *context, gint64 delay)
+{
+    if ( delay > 0 )
+        context->display_handle = g_timeout_add((delay + 999) / 1000, _j4status_core_generate, context);
+    else
+        context->display_handle = g_idle_add(_j4status_core_generate, context);
+}
+
 static void
 _j4status_core_trigger_generate(J4statusCoreContext *context, gboolean force)
 {
+    ++context->frame.updates;
+    ++context->frame.requests;
+
+    if ( force )
+    {
+        ++context->frame.forced;
+        /* Urgent updates skip the frame interval */
+        if ( context->frame.urgent )
+            return;
+        if ( context->display_handle > 0 )
+            g_source_remove(context->display_handle);
+        context->frame.urgent = TRUE;
+        _j4status_core_schedule_generate(context, 0);
+        return;
+    }
+
     if ( context->display_handle > 0 )
         return;
 
-    if ( context->started || force )
-        context->display_handle = g_idle_add(_j4status_core_generate, context);
-    else
+    if ( ! context->started )
+    {
         context->should_display = TRUE;
+        return;
+    }
+
+    gint64 now, deadline;
+    now = g_get_monotonic_time();
+    deadline = MAX(context->frame.last + context->frame.interval, now);
+    deadline = MIN(deadline, now + context->frame.max_latency);
+
+    _j4status_core_schedule_generate(context, deadline - now);
+}
+
+static void
+_j4status_core_update_section(J4statusCoreContext *context, J4statusSection *section, gboolean force)
+{
+    J4statusInputPlugin *plugin = section->core->plugin;
+
+    /* Updates count frames, setter calls are counted by the section */
+    if ( ! section->dirty )
+    {
+        g_ptr_array_add(context->dirty_sections, section);
+        if ( plugin != NULL )
+            ++plugin->stats.updates;
+        ++section->updates;
+    }
+
+    if ( context->tracing )
+    {
+        J4statusTraceEvent event = {
+            .type = J4STATUS_TRACE_SECTION_UPDATE,
+            .name = section->id,
+            .source = ( plugin != NULL ) ? plugin->name : NULL,
+            .start = g_get_monotonic_time(),
+        };
+        _j4status_core_trace(context, &event);
+    }
+
+    _j4status_core_trigger_generate(context, force);
+}
+
+static guint
+_j4status_core_get_output(J4statusCoreContext *context)
+{
+    return context->current_output;
 }
 
 static void
@@ -221,6 +410,12 @@ _j4status_core_stream_reconnect(J4statusCoreStream *stream)
     j4status_io_stream_reconnect(stream);
 }
 
+static gboolean
+_j4status_core_stream_is_terminal(J4statusCoreStream *stream)
+{
+    return j4status_io_stream_is_terminal(stream);
+}
+
 static void
 _j4status_core_stream_free(J4statusCoreStream *stream)
 {
@@ -241,7 +436,7 @@ _j4status_core_start(J4statusCoreContext *context)
             input_plugin->interface.start(input_plugin->context);
     }
     if ( context->should_display && ( context->display_handle == 0 ) )
-        context->display_handle = g_idle_add(_j4status_core_generate, context);
+        _j4status_core_schedule_generate(context, 0);
 }
 
 static void
@@ -259,9 +454,97 @@ _j4status_core_stop(J4statusCoreContext *context)
     context->started = FALSE;
 }
 
+/*
+ * Inputs run unless stopped by SIGUSR2 or idle,
+ * i.e. nobody has been connected for the grace period
+ */
+static void
+_j4status_core_update_state(J4statusCoreContext *context)
+{
+    gboolean run = ( ! context->stopped ) && ( ! context->idle );
+
+    if ( run && ( ! context->started ) )
+        _j4status_core_start(context);
+    else if ( ( ! run ) && context->started )
+        _j4status_core_stop(context);
+}
+
+static gboolean
+_j4status_core_idle_timeout(gpointer user_data)
+{
+    J4statusCoreContext *context = user_data;
+
+    context->idle_handle = 0;
+    g_debug("No subscriber left, stopping inputs");
+    context->idle = TRUE;
+    _j4status_core_update_state(context);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_j4status_core_check_subscribers(J4statusCoreContext *context)
+{
+    if ( context->idle_grace_period < 0 )
+        return;
+    if ( context->idle || ( context->idle_handle > 0 ) )
+        return;
+
+    guint i;
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+    {
+        if ( j4status_io_has_subscribers(g_array_index(context->outputs, J4statusCoreOutput, i).io) )
+            return;
+    }
+
+    context->idle_handle = g_timeout_add(context->idle_grace_period, _j4status_core_idle_timeout, context);
+}
+
+/* Returns TRUE if a fresh line will be generated */
+gboolean
+j4status_core_stream_added(J4statusCoreContext *context)
+{
+    if ( context->idle_handle > 0 )
+        g_source_remove(context->idle_handle);
+    context->idle_handle = 0;
+
+    if ( ! context->idle )
+        return FALSE;
+
+    g_debug("New subscriber, starting inputs");
+    context->idle = FALSE;
+    _j4status_core_update_state(context);
+
+    /*
+     * The client waits for the next frame rather than the last line,
+     * which will carry the inputs' first updates
+     */
+    _j4status_core_trigger_generate(context, FALSE);
+
+    return TRUE;
+}
+
+void
+j4status_core_stream_removed(J4statusCoreContext *context)
+{
+    gboolean has_stream = FALSE;
+    guint i;
+    for ( i = 0 ; ( ! has_stream ) && ( i < context->outputs->len ) ; ++i )
+        has_stream = j4status_io_has_stream(g_array_index(context->outputs, J4statusCoreOutput, i).io);
+
+    if ( has_stream )
+        _j4status_core_check_subscribers(context);
+    else
+        j4status_core_quit(context);
+}
+
 void
 j4status_core_quit(J4statusCoreContext *context)
 {
+    if ( context->idle_handle > 0 )
+        g_source_remove(context->idle_handle);
+    context->idle_handle = 0;
+
     if ( context->started )
         _j4status_core_stop(context);
 
@@ -269,6 +552,88 @@ j4status_core_quit(J4statusCoreContext *context)
         g_main_loop_quit(context->loop);
 }
 
+gchar *
+j4status_core_dump_stats(J4statusCoreContext *context, gsize *length)
+{
+    GKeyFile *stats;
+    stats = g_key_file_new();
+
+    J4statusSection * const *sections;
+    gsize sections_length;
+    sections = j4status_sections_get_array(context->sections, &sections_length);
+
+    g_key_file_set_boolean(stats, "Core", "Started", context->started);
+    g_key_file_set_boolean(stats, "Core", "Idle", context->idle);
+    g_key_file_set_uint64(stats, "Core", "Sections", sections_length);
+    g_key_file_set_uint64(stats, "Core", "UpdateRequests", context->frame.requests);
+    g_key_file_set_uint64(stats, "Core", "ForcedUpdates", context->frame.forced);
+    g_key_file_set_uint64(stats, "Core", "Frames", context->frame.count);
+    g_key_file_set_uint64(stats, "Core", "MergedUpdates", context->frame.merged);
+
+    gchar *group;
+    guint i;
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+    {
+        J4statusCoreOutput *output = &g_array_index(context->outputs, J4statusCoreOutput, i);
+        group = g_strdup_printf("Output %s", output->name);
+        j4status_stats_histogram_dump(&output->generate_time, stats, group, "GenerateTime");
+        j4status_io_dump_stats(output->io, stats, group);
+        if ( output->plugin->interface.dump_stats != NULL )
+            output->plugin->interface.dump_stats(output->plugin->context, stats, group);
+        g_free(group);
+    }
+
+    /* Removed sections were already accounted for */
+    GHashTable *setter_calls;
+    setter_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    for ( i = 0 ; i < sections_length ; ++i )
+    {
+        J4statusSection *section = sections[i];
+        if ( section->core->plugin == NULL )
+            continue;
+        guint64 *calls = g_hash_table_lookup(setter_calls, section->core->plugin);
+        if ( calls == NULL )
+        {
+            calls = g_new0(guint64, 1);
+            g_hash_table_insert(setter_calls, section->core->plugin, calls);
+        }
+        *calls += section->setter_calls;
+    }
+
+    GList *input_plugin_;
+    for ( input_plugin_ = context->input_plugins ; input_plugin_ != NULL ; input_plugin_ = g_list_next(input_plugin_) )
+    {
+        J4statusInputPlugin *input_plugin = input_plugin_->data;
+        guint64 *calls = g_hash_table_lookup(setter_calls, input_plugin);
+        group = g_strdup_printf("Input %s", input_plugin->name);
+        g_key_file_set_uint64(stats, group, "Updates", input_plugin->stats.updates);
+        g_key_file_set_uint64(stats, group, "SetterCalls", input_plugin->stats.setter_calls + ( ( calls != NULL ) ? *calls : 0 ));
+        if ( input_plugin->interface.dump_stats != NULL )
+            input_plugin->interface.dump_stats(input_plugin->context, stats, group);
+        g_free(group);
+    }
+
+    for ( i = 0 ; i < sections_length ; ++i )
+    {
+        J4statusSection *section = sections[i];
+        J4statusInputPlugin *input_plugin = section->core->plugin;
+        group = g_strdup_printf("Section %s", section->id);
+        if ( input_plugin != NULL )
+            g_key_file_set_string(stats, group, "Plugin", input_plugin->name);
+        g_key_file_set_uint64(stats, group, "Updates", section->updates);
+        g_key_file_set_uint64(stats, group, "SetterCalls", section->setter_calls);
+        g_free(group);
+    }
+
+    g_hash_table_unref(setter_calls);
+
+    gchar *data;
+    data = g_key_file_to_data(stats, length, NULL);
+    g_key_file_free(stats);
+
+    return data;
+}
+
 static gboolean
 _j4status_core_source_quit(gpointer user_data)
 {
@@ -280,14 +645,18 @@ _j4status_core_source_quit(gpointer user_data)
 static gboolean
 _j4status_core_signal_usr1(gpointer user_data)
 {
-    _j4status_core_start(user_data);
+    J4statusCoreContext *context = user_data;
+    context->stopped = FALSE;
+    _j4status_core_update_state(context);
     return G_SOURCE_CONTINUE;
 }
 
 static gboolean
 _j4status_core_signal_usr2(gpointer user_data)
 {
-    _j4status_core_stop(user_data);
+    J4statusCoreContext *context = user_data;
+    context->stopped = TRUE;
+    _j4status_core_update_state(context);
     return G_SOURCE_CONTINUE;
 }
 #endif /* G_OS_UNIX */
@@ -297,7 +666,7 @@ main(int argc, char *argv[])
 {
     gboolean print_version = FALSE;
     gboolean one_shot = FALSE;
-    gchar *output_plugin = NULL;
+    gchar **output_plugins = NULL;
     gchar **servers_desc = NULL;
     gchar **streams_desc = NULL;
     gchar **input_plugins = NULL;
@@ -353,14 +722,14 @@ main(int argc, char *argv[])
 
     GOptionEntry entries[] =
     {
-        { "output",     'o', 0, G_OPTION_ARG_STRING,       &output_plugin, "Output plugin to use", "<plugin>" },
-        { "listen",     'l', 0, G_OPTION_ARG_STRING_ARRAY, &servers_desc,  "Socket to listen on, will create a stream on connection (may be specified several times)", "<listen description>" },
-        { "stream",     't', 0, G_OPTION_ARG_STRING_ARRAY, &streams_desc,  "Stream to read from/write to (may be specified several times)", "<stream description>" },
-        { "input",      'i', 0, G_OPTION_ARG_STRING_ARRAY, &input_plugins, "Input plugins to use (may be specified several times)", "<plugin>" },
-        { "order",      'O', 0, G_OPTION_ARG_STRING_ARRAY, &order,         "Order of sections, specified once a section (see man)", "<section id>" },
-        { "one-shot",   '1', 0, G_OPTION_ARG_NONE,         &one_shot,      "Tells j4status to stop right after starting",           NULL },
-        { "config",     'c', 0, G_OPTION_ARG_STRING,       &config,        "Config file to use", "<config>" },
-        { "version",    'V', 0, G_OPTION_ARG_NONE,         &print_version, "Print version",        NULL },
+        { "output",     'o', 0, G_OPTION_ARG_STRING_ARRAY, &output_plugins, "Output plugins to use (may be specified several times)", "<plugin>" },
+        { "listen",     'l', 0, G_OPTION_ARG_STRING_ARRAY, &servers_desc,   "Socket to listen on, will create a stream on connection (may be specified several times)", "<listen description>" },
+        { "stream",     't', 0, G_OPTION_ARG_STRING_ARRAY, &streams_desc,   "Stream to read from/write to (may be specified several times)", "<stream description>" },
+        { "input",      'i', 0, G_OPTION_ARG_STRING_ARRAY, &input_plugins,  "Input plugins to use (may be specified several times)", "<plugin>" },
+        { "order",      'O', 0, G_OPTION_ARG_STRING_ARRAY, &order,          "Order of sections, specified once a section (see man)", "<section id>" },
+        { "one-shot",   '1', 0, G_OPTION_ARG_NONE,         &one_shot,       "Tells j4status to stop right after starting",           NULL },
+        { "config",     'c', 0, G_OPTION_ARG_STRING,       &config,         "Config file to use", "<config>" },
+        { "version",    'V', 0, G_OPTION_ARG_NONE,         &print_version,  "Print version",        NULL },
         { NULL }
     };
 
@@ -394,34 +763,76 @@ main(int argc, char *argv[])
     }
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Plugins");
+    key_file = j4status_config_get_group("Plugins");
     if ( key_file != NULL )
     {
-        if ( output_plugin == NULL )
-            output_plugin = g_key_file_get_string(key_file, "Plugins", "Output", NULL);
+        if ( output_plugins == NULL )
+            output_plugins = g_key_file_get_string_list(key_file, "Plugins", "Output", NULL, NULL);
 
         if ( input_plugins == NULL )
             input_plugins = g_key_file_get_string_list(key_file, "Plugins", "Input", NULL, NULL);
 
         if ( order == NULL )
             order = g_key_file_get_string_list(key_file, "Plugins", "Order", NULL, NULL);
-
-        g_key_file_free(key_file);
     }
 
     J4statusCoreContext *context;
     context = g_new0(J4statusCoreContext, 1);
 
+    gint64 frame_interval = J4STATUS_CORE_DEFAULT_FRAME_INTERVAL;
+    gint64 frame_max_latency = -1;
+    guint64 max_clients = 0;
+    gint64 client_timeout = J4STATUS_CORE_DEFAULT_CLIENT_TIMEOUT;
+    gint64 idle_grace_period = J4STATUS_CORE_DEFAULT_IDLE_GRACE_PERIOD;
+    gchar **stats_servers_desc = NULL;
+    key_file = j4status_config_get_group("Core");
+    if ( key_file != NULL )
+    {
+        gint64 tmp;
+
+        tmp = g_key_file_get_int64(key_file, "Core", "FrameInterval", &error);
+        if ( error == NULL )
+            frame_interval = MAX(tmp, 0);
+        g_clear_error(&error);
+
+        tmp = g_key_file_get_int64(key_file, "Core", "FrameMaxLatency", &error);
+        if ( error == NULL )
+            frame_max_latency = MAX(tmp, 0);
+        g_clear_error(&error);
+
+        max_clients = g_key_file_get_uint64(key_file, "Core", "MaxClients", NULL);
+
+        tmp = g_key_file_get_int64(key_file, "Core", "ClientTimeout", &error);
+        if ( error == NULL )
+            client_timeout = MAX(tmp, 0);
+        g_clear_error(&error);
+
+        tmp = g_key_file_get_int64(key_file, "Core", "IdleGracePeriod", &error);
+        if ( error == NULL )
+            idle_grace_period = MAX(tmp, -1);
+        g_clear_error(&error);
+
+        stats_servers_desc = g_key_file_get_string_list(key_file, "Core", "StatsListen", NULL, NULL);
+    }
+    if ( ( frame_max_latency < 0 ) || ( frame_max_latency > frame_interval ) )
+        frame_max_latency = frame_interval;
+    context->frame.interval = frame_interval * 1000;
+    context->frame.max_latency = frame_max_latency * 1000;
+    context->idle_grace_period = idle_grace_period;
+
     J4statusCoreInterface interface = {
         .context = context,
         .add_section = _j4status_core_add_section,
         .remove_section = _j4status_core_remove_section,
-        .trigger_generate = _j4status_core_trigger_generate,
+        .update_section = _j4status_core_update_section,
         .trigger_action = _j4status_core_trigger_action,
+        .get_output = _j4status_core_get_output,
+        .set_tracing = _j4status_core_set_tracing,
         .stream_get_input_stream = _j4status_core_stream_get_input_stream,
         .stream_get_output_stream = _j4status_core_stream_get_output_stream,
         .stream_reconnect = _j4status_core_stream_reconnect,
         .stream_free = _j4status_core_stream_free,
+        .stream_is_terminal = _j4status_core_stream_is_terminal,
     };
 
 #ifdef G_OS_UNIX
@@ -435,22 +846,79 @@ main(int argc, char *argv[])
     signal(SIGPIPE, SIG_IGN);
 #endif /* G_OS_UNIX */
 
-    context->output_plugin = j4status_plugins_get_output_plugin(&interface, output_plugin);
-    if ( context->output_plugin == NULL )
+    if ( output_plugins == NULL )
     {
-        g_warning("No usable output plugin, tried '%s'", output_plugin);
-        retval = 10;
-        goto end;
+        output_plugins = g_new0(gchar *, 2);
+        output_plugins[0] = g_strdup("flat");
     }
 
-    /* Creating input/output stream */
-    context->io = j4status_io_new(context, context->output_plugin, (const gchar * const *) servers_desc, (const gchar * const *) streams_desc);
-    if ( context->io == NULL )
+    context->outputs = g_array_new(FALSE, TRUE, sizeof(J4statusCoreOutput));
+
+    gchar **output_plugin;
+    for ( output_plugin = output_plugins ; *output_plugin != NULL ; ++output_plugin )
     {
-        g_warning("Couldn't create input/output streams");
-        retval = 2;
-        goto end;
+        /*
+         * The first output uses the command-line streams,
+         * others have theirs in their [Output <plugin>] section
+         */
+        gboolean first = ( output_plugin == output_plugins );
+        gchar **output_servers_desc = NULL;
+        gchar **output_streams_desc = NULL;
+        if ( ! first )
+        {
+            gchar *group;
+            group = g_strdup_printf("Output %s", *output_plugin);
+            key_file = j4status_config_get_group(group);
+            if ( key_file != NULL )
+            {
+                output_servers_desc = g_key_file_get_string_list(key_file, group, "Listen", NULL, NULL);
+                output_streams_desc = g_key_file_get_string_list(key_file, group, "Streams", NULL, NULL);
+            }
+            g_free(group);
+
+            if ( ( output_servers_desc == NULL ) && ( output_streams_desc == NULL ) )
+            {
+                g_warning("No stream for output plugin '%s', skipping", *output_plugin);
+                continue;
+            }
+        }
+
+        J4statusCoreOutput output = { .name = *output_plugin };
+        context->current_output = context->outputs->len;
+        output.plugin = j4status_plugins_get_output_plugin(&interface, *output_plugin);
+        if ( output.plugin == NULL )
+        {
+            g_warning("No usable output plugin, tried '%s'", *output_plugin);
+            g_strfreev(output_servers_desc);
+            g_strfreev(output_streams_desc);
+            if ( ! first )
+                continue;
+            retval = 10;
+            goto end;
+        }
+
+        /* Creating input/output stream */
+        if ( first )
+            output.io = j4status_io_new(context, output.plugin, (const gchar * const *) servers_desc, (const gchar * const *) streams_desc, TRUE);
+        else
+            output.io = j4status_io_new(context, output.plugin, (const gchar * const *) output_servers_desc, (const gchar * const *) output_streams_desc, FALSE);
+        g_strfreev(output_servers_desc);
+        g_strfreev(output_streams_desc);
+        if ( output.io == NULL )
+        {
+            g_warning("Couldn't create input/output streams for output plugin '%s'", *output_plugin);
+            if ( output.plugin->interface.uninit != NULL )
+                output.plugin->interface.uninit(output.plugin->context);
+            if ( ! first )
+                continue;
+            retval = 2;
+            goto end;
+        }
+        j4status_io_set_limits(output.io, MIN(max_clients, G_MAXUINT), client_timeout * 1000);
+
+        g_array_append_val(context->outputs, output);
     }
+    context->current_output = 0;
 
     if ( order != NULL )
     {
@@ -461,8 +929,16 @@ main(int argc, char *argv[])
         g_free(order);
     }
 
+    context->sections = j4status_sections_new();
+    context->dirty_sections = g_ptr_array_new();
     context->sections_hash = g_hash_table_new(g_str_hash, g_str_equal);
 
+    if ( stats_servers_desc != NULL )
+    {
+        context->stats = j4status_stats_new(context, (const gchar * const *) stats_servers_desc);
+        g_strfreev(stats_servers_desc);
+    }
+
     context->input_plugins = j4status_plugins_get_input_plugins(&interface, input_plugins);
     if ( context->input_plugins == NULL )
     {
@@ -470,11 +946,8 @@ main(int argc, char *argv[])
         one_shot = TRUE;
         retval = 11;
     }
-    context->sections = g_list_reverse(context->sections);
-    if ( context->order_weights != NULL )
-        context->sections = g_list_sort(context->sections, _j4status_core_compare_sections);
-
     _j4status_core_start(context);
+    _j4status_core_check_subscribers(context);
 
     if ( one_shot )
         g_idle_add(_j4status_core_source_quit, context);
@@ -484,6 +957,19 @@ main(int argc, char *argv[])
     g_main_loop_unref(context->loop);
     context->loop = NULL;
 
+    if ( context->display_handle > 0 )
+        g_source_remove(context->display_handle);
+    context->display_handle = 0;
+
+    if ( context->stats != NULL )
+        j4status_stats_free(context->stats);
+
+    guint i;
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+        j4status_io_flush(g_array_index(context->outputs, J4statusCoreOutput, i).io);
+
+    g_debug("Generated %" G_GUINT64_FORMAT " frames, merged %" G_GUINT64_FORMAT " updates", context->frame.count, context->frame.merged);
+
     GList *input_plugin_;
     J4statusInputPlugin *input_plugin;
     for ( input_plugin_ = context->input_plugins ; input_plugin_ != NULL ; input_plugin_ = g_list_next(input_plugin_) )
@@ -492,15 +978,24 @@ main(int argc, char *argv[])
         input_plugin->interface.uninit(input_plugin->context);
     }
 
-    if ( context->output_plugin->interface.uninit != NULL )
-        context->output_plugin->interface.uninit(context->output_plugin->context);
+    for ( i = 0 ; i < context->outputs->len ; ++i )
+    {
+        J4statusCoreOutput *output = &g_array_index(context->outputs, J4statusCoreOutput, i);
 
-    j4status_io_free(context->io);
+        if ( output->plugin->interface.uninit != NULL )
+            output->plugin->interface.uninit(output->plugin->context);
+
+        j4status_io_free(output->io);
+    }
+    g_array_unref(context->outputs);
+    g_strfreev(output_plugins);
 
     if ( context->order_weights != NULL )
         g_hash_table_unref(context->order_weights);
 
     g_hash_table_unref(context->sections_hash);
+    g_ptr_array_unref(context->dirty_sections);
+    j4status_sections_free(context->sections);
 
 end:
 #ifdef J4STATUS_DEBUG_OUTPUT
@@ -26,6 +26,10 @@
 #include "types.h"
 
 void j4status_core_action(J4statusCoreContext *context, gchar *action_description);
+gboolean j4status_core_stream_added(J4statusCoreContext *context);
+void j4status_core_stream_removed(J4statusCoreContext *context);
 void j4status_core_quit(J4statusCoreContext *context);
+gchar *j4status_core_dump_stats(J4statusCoreContext *context, gsize *length);
+void j4status_core_trace_write(J4statusCoreContext *context, J4statusIOContext *io, guint64 stream, gint64 start, gsize size);
 
 #endif /* __J4STATUS_J4STATUS_H__ */
@@ -177,11 +177,15 @@ j4status_plugins_get_input_plugin(J4statusCoreInterface *core, const gchar *name
     plugin = g_new0(J4statusInputPlugin, 1);
     plugin->module = module;
 
+    /* Each input plugin gets its own copy so we know where sections come from */
+    plugin->core = *core;
+    plugin->core.plugin = plugin;
+
     func(&plugin->interface);
 
     if ( plugin->interface.init != NULL )
     {
-        plugin->context = plugin->interface.init(core);
+        plugin->context = plugin->interface.init(&plugin->core);
         if ( plugin->context == NULL )
         {
             /*
@@ -193,6 +197,7 @@ j4status_plugins_get_input_plugin(J4statusCoreInterface *core, const gchar *name
             return NULL;
         }
     }
+    plugin->name = g_strdup(name);
 
     return plugin;
 }
@@ -31,8 +31,14 @@ typedef struct {
 
 typedef struct {
     gpointer module;
+    gchar *name;
+    J4statusCoreInterface core;
     J4statusPluginContext *context;
     J4statusInputPluginInterface interface;
+    struct {
+        guint64 updates;
+        guint64 setter_calls;
+    } stats;
 } J4statusInputPlugin;
 
 J4statusOutputPlugin *j4status_plugins_get_output_plugin(J4statusCoreInterface *core, const gchar *name);
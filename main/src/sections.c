@@ -0,0 +1,170 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "j4status-plugin-output.h"
+#include "j4status-plugin-input.h"
+#include "j4status-plugin-private.h"
+
+#include "sections.h"
+
+/*
+ * Sections are ordered by (weight, serial) in a balanced tree,
+ * the serial keeping insertion order between equal weights,
+ * so adding or removing one is O(log n).
+ * Outputs walk a contiguous copy of that order, rebuilt at most
+ * once per frame, and only after sections were added or removed.
+ * Each section also gets a slot index which is stable for its lifetime.
+ */
+struct _J4statusSections {
+    GSequence *sequence;
+    GPtrArray *sorted;
+    gboolean sorted_dirty;
+    GPtrArray *slots;
+    GArray *free_slots;
+    guint64 serial;
+    GList *list;
+    gboolean list_dirty;
+};
+
+static gint
+_j4status_sections_compare(gconstpointer a_, gconstpointer b_, G_GNUC_UNUSED gpointer user_data)
+{
+    const J4statusSection *a = a_, *b = b_;
+    if ( a->weight != b->weight )
+        return ( a->weight < b->weight ) ? -1 : 1;
+    if ( a->serial != b->serial )
+        return ( a->serial < b->serial ) ? -1 : 1;
+    return 0;
+}
+
+J4statusSections *
+j4status_sections_new(void)
+{
+    J4statusSections *self;
+    self = g_slice_new0(J4statusSections);
+
+    self->sequence = g_sequence_new(NULL);
+    self->sorted = g_ptr_array_new();
+    self->slots = g_ptr_array_new();
+    self->free_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+
+    return self;
+}
+
+void
+j4status_sections_free(J4statusSections *self)
+{
+    g_list_free(self->list);
+    g_array_unref(self->free_slots);
+    g_ptr_array_unref(self->slots);
+    g_ptr_array_unref(self->sorted);
+    g_sequence_free(self->sequence);
+
+    g_slice_free(J4statusSections, self);
+}
+
+void
+j4status_sections_add(J4statusSections *self, J4statusSection *section)
+{
+    section->serial = ++self->serial;
+
+    if ( self->free_slots->len > 0 )
+    {
+        section->index = g_array_index(self->free_slots, guint, self->free_slots->len - 1);
+        g_array_set_size(self->free_slots, self->free_slots->len - 1);
+        g_ptr_array_index(self->slots, section->index) = section;
+    }
+    else
+    {
+        section->index = self->slots->len;
+        g_ptr_array_add(self->slots, section);
+    }
+
+    g_sequence_insert_sorted(self->sequence, section, _j4status_sections_compare, NULL);
+    self->sorted_dirty = TRUE;
+    self->list_dirty = TRUE;
+}
+
+void
+j4status_sections_remove(J4statusSections *self, J4statusSection *section)
+{
+    GSequenceIter *iter;
+    iter = g_sequence_lookup(self->sequence, section, _j4status_sections_compare, NULL);
+    if ( iter == NULL )
+        return;
+
+    g_sequence_remove(iter);
+    g_ptr_array_index(self->slots, section->index) = NULL;
+    g_array_append_val(self->free_slots, section->index);
+    self->sorted_dirty = TRUE;
+    self->list_dirty = TRUE;
+}
+
+J4statusSection * const *
+j4status_sections_get_array(J4statusSections *self, gsize *length)
+{
+    if ( self->sorted_dirty )
+    {
+        g_ptr_array_set_size(self->sorted, 0);
+
+        GSequenceIter *iter;
+        for ( iter = g_sequence_get_begin_iter(self->sequence) ; ! g_sequence_iter_is_end(iter) ; iter = g_sequence_iter_next(iter) )
+            g_ptr_array_add(self->sorted, g_sequence_get(iter));
+        self->sorted_dirty = FALSE;
+    }
+
+    *length = self->sorted->len;
+    return (J4statusSection * const *) self->sorted->pdata;
+}
+
+J4statusSection *
+j4status_sections_get_slot(J4statusSections *self, guint index)
+{
+    if ( index >= self->slots->len )
+        return NULL;
+    return g_ptr_array_index(self->slots, index);
+}
+
+/* Compatibility list for GList-based output plugins, only rebuilt on structural changes */
+GList *
+j4status_sections_get_list(J4statusSections *self)
+{
+    if ( ! self->list_dirty )
+        return self->list;
+
+    g_list_free(self->list);
+    self->list = NULL;
+
+    GSequenceIter *iter;
+    for ( iter = g_sequence_get_end_iter(self->sequence) ; ! g_sequence_iter_is_begin(iter) ; )
+    {
+        iter = g_sequence_iter_prev(iter);
+        self->list = g_list_prepend(self->list, g_sequence_get(iter));
+    }
+    self->list_dirty = FALSE;
+
+    return self->list;
+}
@@ -0,0 +1,38 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __J4STATUS_SECTIONS_H__
+#define __J4STATUS_SECTIONS_H__
+
+#include "types.h"
+
+J4statusSections *j4status_sections_new(void);
+void j4status_sections_free(J4statusSections *self);
+
+void j4status_sections_add(J4statusSections *self, J4statusSection *section);
+void j4status_sections_remove(J4statusSections *self, J4statusSection *section);
+
+J4statusSection * const *j4status_sections_get_array(J4statusSections *self, gsize *length);
+J4statusSection *j4status_sections_get_slot(J4statusSections *self, guint index);
+GList *j4status_sections_get_list(J4statusSections *self);
+
+#endif /* __J4STATUS_SECTIONS_H__ */
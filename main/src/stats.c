@@ -0,0 +1,217 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "j4status-plugin-output.h"
+#include "j4status-plugin-input.h"
+#include "j4status-plugin-private.h"
+#include "plugins.h"
+
+#include "j4status.h"
+#include "io.h"
+
+#include "stats.h"
+
+/*
+ * The stats server dumps a key file with the core and per-output counters
+ * to each connecting client, then closes the connection.
+ */
+struct _J4statusStats {
+    J4statusCoreContext *core;
+    GSocketService *server;
+    GList *paths_to_unlink;
+};
+
+typedef struct {
+    GSocketConnection *connection;
+    GBytes *data;
+} J4statusStatsClient;
+
+void
+j4status_stats_histogram_add(J4statusStatsHistogram *histogram, guint64 value)
+{
+    guint bucket = 0;
+    while ( ( value >> bucket ) > 0 )
+        ++bucket;
+    bucket = MIN(bucket, J4STATUS_STATS_HISTOGRAM_BUCKETS - 1);
+
+    ++histogram->count;
+    histogram->sum += value;
+    histogram->max = MAX(histogram->max, value);
+    ++histogram->buckets[bucket];
+}
+
+void
+j4status_stats_histogram_dump(const J4statusStatsHistogram *histogram, GKeyFile *stats, const gchar *group, const gchar *key)
+{
+    gchar *name;
+
+    name = g_strconcat(key, "Count", NULL);
+    g_key_file_set_uint64(stats, group, name, histogram->count);
+    g_free(name);
+
+    name = g_strconcat(key, "Sum", NULL);
+    g_key_file_set_uint64(stats, group, name, histogram->sum);
+    g_free(name);
+
+    name = g_strconcat(key, "Max", NULL);
+    g_key_file_set_uint64(stats, group, name, histogram->max);
+    g_free(name);
+
+    /* Trailing empty buckets are omitted */
+    guint length = J4STATUS_STATS_HISTOGRAM_BUCKETS;
+    while ( ( length > 0 ) && ( histogram->buckets[length - 1] == 0 ) )
+        --length;
+
+    GString *value;
+    value = g_string_new("");
+    guint i;
+    for ( i = 0 ; i < length ; ++i )
+        g_string_append_printf(value, "%" G_GUINT64_FORMAT ";", histogram->buckets[i]);
+
+    name = g_strconcat(key, "Histogram", NULL);
+    g_key_file_set_value(stats, group, name, value->str);
+    g_free(name);
+    g_string_free(value, TRUE);
+}
+
+static void _j4status_stats_client_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data);
+
+static void
+_j4status_stats_client_free(J4statusStatsClient *client)
+{
+    g_io_stream_close(G_IO_STREAM(client->connection), NULL, NULL);
+    g_object_unref(client->connection);
+    g_bytes_unref(client->data);
+    g_slice_free(J4statusStatsClient, client);
+}
+
+static void
+_j4status_stats_client_write(J4statusStatsClient *client)
+{
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(client->connection));
+    g_output_stream_write_bytes_async(out, client->data, G_PRIORITY_LOW, NULL, _j4status_stats_client_write_callback, client);
+}
+
+static void
+_j4status_stats_client_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    J4statusStatsClient *client = user_data;
+
+    GError *error = NULL;
+    gssize written;
+    written = g_output_stream_write_bytes_finish(G_OUTPUT_STREAM(obj), res, &error);
+    if ( written < 0 )
+    {
+        g_debug("Couldn't write stats: %s", error->message);
+        g_clear_error(&error);
+        _j4status_stats_client_free(client);
+        return;
+    }
+
+    gsize size = g_bytes_get_size(client->data);
+    if ( (gsize) written < size )
+    {
+        GBytes *rest;
+        rest = g_bytes_new_from_bytes(client->data, written, size - written);
+        g_bytes_unref(client->data);
+        client->data = rest;
+        _j4status_stats_client_write(client);
+        return;
+    }
+
+    _j4status_stats_client_free(client);
+}
+
+static gboolean
+_j4status_stats_server_callback(G_GNUC_UNUSED GSocketService *service, GSocketConnection *connection, G_GNUC_UNUSED GObject *source_object, gpointer user_data)
+{
+    J4statusStats *self = user_data;
+
+    gchar *data;
+    gsize length;
+    data = j4status_core_dump_stats(self->core, &length);
+
+    J4statusStatsClient *client;
+    client = g_slice_new0(J4statusStatsClient);
+    client->connection = g_object_ref(connection);
+    client->data = g_bytes_new_take(data, length);
+
+    _j4status_stats_client_write(client);
+
+    return FALSE;
+}
+
+J4statusStats *
+j4status_stats_new(J4statusCoreContext *core, const gchar * const *servers_desc)
+{
+    J4statusStats *self;
+    self = g_new0(J4statusStats, 1);
+    self->core = core;
+    self->server = g_socket_service_new();
+
+    gboolean listening = FALSE;
+    const gchar * const *server_desc;
+    for ( server_desc = servers_desc ; *server_desc != NULL ; ++server_desc )
+    {
+        gchar *path;
+        if ( ! j4status_io_listener_add(G_SOCKET_LISTENER(self->server), *server_desc, &path) )
+            continue;
+        if ( path != NULL )
+            self->paths_to_unlink = g_list_prepend(self->paths_to_unlink, path);
+        listening = TRUE;
+    }
+
+    if ( ! listening )
+    {
+        j4status_stats_free(self);
+        return NULL;
+    }
+
+    g_signal_connect(self->server, "incoming", (GCallback) _j4status_stats_server_callback, self);
+
+    return self;
+}
+
+static void
+_j4status_stats_unlink_path(gpointer data)
+{
+    gchar *path = data;
+    g_unlink(path);
+    g_free(path);
+}
+
+void
+j4status_stats_free(J4statusStats *self)
+{
+    g_socket_service_stop(self->server);
+    g_object_unref(self->server);
+    g_list_free_full(self->paths_to_unlink, _j4status_stats_unlink_path);
+
+    g_free(self);
+}
@@ -0,0 +1,47 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __J4STATUS_STATS_H__
+#define __J4STATUS_STATS_H__
+
+#include "types.h"
+
+#define J4STATUS_STATS_HISTOGRAM_BUCKETS 24
+
+/*
+ * Bucket 0 counts zeros, bucket n counts values in [2^(n-1), 2^n[,
+ * the last one counts everything above
+ */
+typedef struct {
+    guint64 count;
+    guint64 sum;
+    guint64 max;
+    guint64 buckets[J4STATUS_STATS_HISTOGRAM_BUCKETS];
+} J4statusStatsHistogram;
+
+void j4status_stats_histogram_add(J4statusStatsHistogram *histogram, guint64 value);
+void j4status_stats_histogram_dump(const J4statusStatsHistogram *histogram, GKeyFile *stats, const gchar *group, const gchar *key);
+
+J4statusStats *j4status_stats_new(J4statusCoreContext *core, const gchar * const *servers_desc);
+void j4status_stats_free(J4statusStats *stats);
+
+#endif /* __J4STATUS_STATS_H__ */
@@ -26,5 +26,8 @@
 typedef struct _J4statusCoreContext J4statusCoreContext;
 typedef struct _J4statusIOContext J4statusIOContext;
 typedef struct _J4statusIOStream J4statusIOStream;
+typedef struct _J4statusIOWrite J4statusIOWrite;
+typedef struct _J4statusSections J4statusSections;
+typedef struct _J4statusStats J4statusStats;
 
 #endif /* __J4STATUS_TYPES_H__ */
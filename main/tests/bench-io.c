@@ -0,0 +1,323 @@
+/*
+ * j4status - Status line generator
+ *
+ * Copyright © 2012-2018 Quentin "Sardem FF7" Glidic
+ *
+ * This file is part of j4status.
+ *
+ * j4status is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * j4status is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with j4status. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Fans frames out to 1000 unix socket clients, and measures the time
+ * until every reading client got the whole frame
+ * A few more clients never read and must get evicted, and the ones
+ * above MaxClients must get rejected
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "j4status-plugin-output.h"
+#include "j4status-plugin-input.h"
+#include "j4status-plugin-private.h"
+#include "plugins.h"
+#include "j4status.h"
+#include "io.h"
+
+#define READERS 1000
+#define SLOW 8
+#define EXTRA 4
+#define BATCH 64
+#define FRAMES 200
+#define FRAME_SIZE 4096
+#define CLIENT_TIMEOUT ( 100 * 1000 )
+
+#define HEADER "{\"version\":1}\n[[]\n"
+
+struct _J4statusPluginContext {
+    GBytes *frame;
+};
+
+struct _J4statusOutputPluginStream {
+    J4statusCoreStream *stream;
+};
+
+typedef struct {
+    GSocketConnection *connection;
+    gchar buffer[64 * 1024];
+} J4statusBenchClient;
+
+static guint64 _bench_added;
+static guint64 _bench_received;
+
+/* The bits of the core io.c needs */
+
+gboolean
+j4status_core_stream_added(G_GNUC_UNUSED J4statusCoreContext *context)
+{
+    ++_bench_added;
+    return FALSE;
+}
+
+void
+j4status_core_stream_removed(G_GNUC_UNUSED J4statusCoreContext *context)
+{
+}
+
+void
+j4status_core_trace_write(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED J4statusIOContext *io, G_GNUC_UNUSED guint64 stream, G_GNUC_UNUSED gint64 start, G_GNUC_UNUSED gsize size)
+{
+}
+
+gchar *
+j4status_core_dump_stats(G_GNUC_UNUSED J4statusCoreContext *context, G_GNUC_UNUSED gsize *length)
+{
+    return NULL;
+}
+
+/* A plugin giving the same frame to every stream, like i3bar does */
+
+static J4statusOutputPluginStream *
+_bench_stream_new(G_GNUC_UNUSED J4statusPluginContext *context, J4statusCoreStream *core_stream)
+{
+    J4statusOutputPluginStream *stream;
+    stream = g_slice_new0(J4statusOutputPluginStream);
+    stream->stream = core_stream;
+    return stream;
+}
+
+static void
+_bench_stream_free(G_GNUC_UNUSED J4statusPluginContext *context, J4statusOutputPluginStream *stream)
+{
+    g_slice_free(J4statusOutputPluginStream, stream);
+}
+
+static gboolean
+_bench_send_header(G_GNUC_UNUSED J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
+{
+    return g_output_stream_write_all(j4status_io_stream_get_output_stream(stream->stream), HEADER, strlen(HEADER), NULL, NULL, error);
+}
+
+static gboolean
+_bench_get_line(J4statusPluginContext *context, GPtrArray *chunks)
+{
+    g_ptr_array_add(chunks, g_bytes_ref(context->frame));
+    return TRUE;
+}
+
+static void
+_bench_client_read_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    J4statusBenchClient *client = user_data;
+
+    gssize r;
+    r = g_input_stream_read_finish(G_INPUT_STREAM(obj), res, NULL);
+    if ( r <= 0 )
+        return;
+
+    _bench_received += r;
+    g_input_stream_read_async(G_INPUT_STREAM(obj), client->buffer, sizeof(client->buffer), G_PRIORITY_DEFAULT, NULL, _bench_client_read_callback, client);
+}
+
+static gboolean
+_bench_connect(GSocketAddress *address, J4statusBenchClient *clients, guint length)
+{
+    GSocketClient *socket_client;
+    socket_client = g_socket_client_new();
+
+    GError *error = NULL;
+    guint i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        clients[i].connection = g_socket_client_connect(socket_client, G_SOCKET_CONNECTABLE(address), NULL, &error);
+        if ( clients[i].connection == NULL )
+        {
+            g_printerr("Couldn't connect client %u: %s\n", i, error->message);
+            g_clear_error(&error);
+            g_object_unref(socket_client);
+            return FALSE;
+        }
+    }
+
+    g_object_unref(socket_client);
+    return TRUE;
+}
+
+static guint64
+_bench_get_stat(J4statusIOContext *io, const gchar *key)
+{
+    GKeyFile *stats;
+    stats = g_key_file_new();
+    j4status_io_dump_stats(io, stats, "IO");
+
+    guint64 value;
+    value = g_key_file_get_uint64(stats, "IO", key, NULL);
+    g_key_file_free(stats);
+
+    return value;
+}
+
+static gboolean
+_bench_check_stat(J4statusIOContext *io, const gchar *key, guint64 expected)
+{
+    guint64 value = _bench_get_stat(io, key);
+    if ( value == expected )
+        return TRUE;
+
+    g_printerr("%s: expected %" G_GUINT64_FORMAT ", got %" G_GUINT64_FORMAT "\n", key, expected, value);
+    return FALSE;
+}
+
+int
+main(G_GNUC_UNUSED int argc, G_GNUC_UNUSED char *argv[])
+{
+    /* Both ends of every connection live here */
+    struct rlimit limit;
+    if ( getrlimit(RLIMIT_NOFILE, &limit) == 0 )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if ( ( getrlimit(RLIMIT_NOFILE, &limit) < 0 ) || ( limit.rlim_cur < 2 * ( READERS + SLOW + EXTRA ) + 64 ) )
+    {
+        g_printerr("Not enough file descriptors for %u clients\n", READERS + SLOW + EXTRA);
+        return 77;
+    }
+
+    GError *error = NULL;
+    gchar *dir;
+    dir = g_dir_make_tmp("j4status-bench-XXXXXX", &error);
+    if ( dir == NULL )
+    {
+        g_printerr("Couldn't create the socket directory: %s\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+
+    gchar *path = g_build_filename(dir, "socket", NULL);
+    gchar *server_desc = g_strconcat("unix:", path, NULL);
+    const gchar * const servers_desc[] = { server_desc, NULL };
+
+    J4statusPluginContext context;
+    gchar *frame = g_malloc(FRAME_SIZE);
+    memset(frame, 'x', FRAME_SIZE - 1);
+    frame[FRAME_SIZE - 1] = '\n';
+    context.frame = g_bytes_new_take(frame, FRAME_SIZE);
+
+    J4statusOutputPlugin plugin = {
+        .context = &context,
+        .interface = {
+            .stream_new = _bench_stream_new,
+            .stream_free = _bench_stream_free,
+            .send_header = _bench_send_header,
+            .get_line = _bench_get_line,
+        },
+    };
+
+    J4statusIOContext *io;
+    io = j4status_io_new(NULL, &plugin, servers_desc, NULL, FALSE);
+    if ( io == NULL )
+        return 1;
+    j4status_io_set_limits(io, READERS + SLOW, CLIENT_TIMEOUT);
+
+    GSocketAddress *address;
+    address = g_unix_socket_address_new(path);
+
+    /* In batches, so that we never go over the server backlog */
+    J4statusBenchClient *clients = g_new0(J4statusBenchClient, READERS + SLOW + EXTRA);
+    gboolean r = TRUE;
+    guint i;
+    for ( i = 0 ; r && ( i < READERS + SLOW ) ; i += BATCH )
+    {
+        guint length = MIN(BATCH, READERS + SLOW - i);
+        r = _bench_connect(address, clients + i, length);
+        while ( r && ( _bench_added < i + length ) )
+            g_main_context_iteration(NULL, TRUE);
+    }
+
+    /* Over MaxClients, the server closes these right away */
+    if ( r )
+        r = _bench_connect(address, clients + READERS + SLOW, EXTRA);
+    for ( i = READERS + SLOW ; r && ( i < READERS + SLOW + EXTRA ) ; ++i )
+    {
+        GSocket *socket = g_socket_connection_get_socket(clients[i].connection);
+        while ( g_socket_condition_check(socket, G_IO_IN | G_IO_HUP) == 0 )
+            g_main_context_iteration(NULL, TRUE);
+    }
+
+    if ( ! r )
+        goto end;
+
+    for ( i = 0 ; i < READERS ; ++i )
+    {
+        GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(clients[i].connection));
+        g_input_stream_read_async(in, clients[i].buffer, sizeof(clients[i].buffer), G_PRIORITY_DEFAULT, NULL, _bench_client_read_callback, &clients[i]);
+    }
+
+    guint64 expected = (guint64) READERS * strlen(HEADER);
+    while ( _bench_received < expected )
+        g_main_context_iteration(NULL, TRUE);
+
+    gint64 duration = 0;
+    guint frame_n;
+    for ( frame_n = 0 ; frame_n < FRAMES ; ++frame_n )
+    {
+        gint64 start = g_get_monotonic_time();
+        j4status_io_update_line(io);
+        expected += (guint64) READERS * FRAME_SIZE;
+        while ( _bench_received < expected )
+            g_main_context_iteration(NULL, TRUE);
+        duration += g_get_monotonic_time() - start;
+    }
+
+    g_print("%u clients (%u not reading), %u frames of %u bytes: %.1f µs per frame, %.1f ns per client\n", READERS, SLOW, FRAMES, FRAME_SIZE, (gdouble) duration / FRAMES, (gdouble) duration * 1000. / FRAMES / READERS);
+
+    /* Clients which did not read for ClientTimeout are gone on the next frame */
+    g_usleep(CLIENT_TIMEOUT);
+    j4status_io_update_line(io);
+    expected += (guint64) READERS * FRAME_SIZE;
+    while ( _bench_received < expected )
+        g_main_context_iteration(NULL, TRUE);
+
+    r = _bench_check_stat(io, "AcceptedClients", READERS + SLOW) && r;
+    r = _bench_check_stat(io, "RejectedClients", EXTRA) && r;
+    r = _bench_check_stat(io, "EvictedClients", SLOW) && r;
+    r = _bench_check_stat(io, "Clients", READERS) && r;
+
+end:
+    j4status_io_free(io);
+    for ( i = 0 ; i < READERS + SLOW + EXTRA ; ++i )
+    {
+        if ( clients[i].connection != NULL )
+            g_object_unref(clients[i].connection);
+    }
+    g_free(clients);
+    g_object_unref(address);
+    g_bytes_unref(context.frame);
+    g_rmdir(dir);
+    g_free(server_desc);
+    g_free(path);
+    g_free(dir);
+
+    return r ? 0 : 1;
+}
@@ -22,6 +22,8 @@
 
 #include "config.h"
 
+#include <unistd.h>
+
 #include <glib.h>
 #include <glib/gprintf.h>
 
@@ -29,10 +31,18 @@
 
 #define BOOL_TO_S(bool) ((bool) ? "yes" : "no")
 
+/* Trace viewer lanes, streams get one each after the fixed ones */
+#define TRACE_TID_UPDATE 1
+#define TRACE_TID_GENERATE 2
+#define TRACE_TID_STREAM 16
+
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     gsize last_len;
     GString *line;
+    gboolean trace;
+    gulong pid;
+    GString *events;
 };
 
 struct _J4statusOutputPluginStream {
@@ -53,12 +63,26 @@ _j4status_debug_init(J4statusCoreInterface *core)
 
     context->line = g_string_new("");
 
+    GKeyFile *key_file;
+    key_file = j4status_config_get_group("Debug");
+    if ( key_file != NULL )
+        context->trace = g_key_file_get_boolean(key_file, "Debug", "Trace", NULL);
+
+    if ( context->trace )
+    {
+        j4status_core_set_tracing(core, TRUE);
+        context->pid = getpid();
+        context->events = g_string_new("");
+    }
+
     return context;
 }
 
 static void
 _j4status_debug_uninit(J4statusPluginContext *context)
 {
+    if ( context->events != NULL )
+        g_string_free(context->events, TRUE);
     g_string_free(context->line, TRUE);
 
     g_free(context);
@@ -112,15 +136,108 @@ _j4status_debug_stream_free(J4statusPluginContext *context, J4statusOutputPlugin
 }
 
 static void
-_j4status_debug_generate_line(J4statusPluginContext *context, GList *sections)
+_j4status_debug_append_json_string(GString *string, const gchar *s)
+{
+    if ( s == NULL )
+    {
+        g_string_append(string, "null");
+        return;
+    }
+
+    g_string_append_c(string, '"');
+    for ( ; *s != '\0' ; ++s )
+    {
+        switch ( *s )
+        {
+        case '"':
+        case '\\':
+            g_string_append_c(string, '\\');
+            g_string_append_c(string, *s);
+        break;
+        default:
+            if ( (guchar) *s < 0x20 )
+                g_string_append_printf(string, "\\u%04x", (guint) *s);
+            else
+                g_string_append_c(string, *s);
+        }
+    }
+    g_string_append_c(string, '"');
+}
+
+/*
+ * Chrome trace event format, in its JSON array flavour
+ * The closing bracket is optional, and a trailing comma is accepted,
+ * so a stream cut at any point is still a valid trace
+ */
+static void
+_j4status_debug_trace(J4statusPluginContext *context, const J4statusTraceEvent *event)
+{
+    if ( ! context->trace )
+        return;
+
+    GString *events = context->events;
+    guint64 tid = 0;
+
+    g_string_append(events, "{\"name\":");
+    _j4status_debug_append_json_string(events, event->name);
+    switch ( event->type )
+    {
+    case J4STATUS_TRACE_SECTION_UPDATE:
+        tid = TRACE_TID_UPDATE;
+        g_string_append(events, ",\"cat\":\"update\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"plugin\":");
+        _j4status_debug_append_json_string(events, event->source);
+        g_string_append_c(events, '}');
+    break;
+    case J4STATUS_TRACE_GENERATE:
+        tid = TRACE_TID_GENERATE;
+        g_string_append_printf(events, ",\"cat\":\"generate\",\"ph\":\"X\",\"dur\":%" G_GINT64_FORMAT, event->duration);
+    break;
+    case J4STATUS_TRACE_STREAM_WRITE:
+        tid = TRACE_TID_STREAM + event->stream;
+        g_string_append_printf(events, ",\"cat\":\"write\",\"ph\":\"X\",\"dur\":%" G_GINT64_FORMAT ",\"args\":{\"stream\":%" G_GUINT64_FORMAT ",\"size\":%" G_GSIZE_FORMAT "}", event->duration, event->stream, event->size);
+    break;
+    }
+    g_string_append_printf(events, ",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%lu,\"tid\":%" G_GUINT64_FORMAT "},\n", event->start, context->pid, tid);
+}
+
+static gboolean
+_j4status_debug_send_header(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
+{
+    if ( ! context->trace )
+        return TRUE;
+
+    gchar *header;
+    gboolean r;
+    header = g_strdup_printf("[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%d,\"args\":{\"name\":\"Section updates\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%d,\"args\":{\"name\":\"Generate\"}},\n",
+        context->pid, TRACE_TID_UPDATE,
+        context->pid, TRACE_TID_GENERATE);
+    r = g_data_output_stream_put_string(stream->out, header, NULL, error);
+    g_free(header);
+
+    return r;
+}
+
+static void
+_j4status_debug_generate_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
 {
     g_string_truncate(context->line, 0);
+
+    if ( context->trace )
+    {
+        /* Events of this very frame will come with the next one */
+        g_string_append_len(context->line, context->events->str, context->events->len);
+        g_string_truncate(context->events, 0);
+        return;
+    }
+
     gboolean first = TRUE;
-    GList *section_;
+    gsize i;
     J4statusSection *section;
-    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    for ( i = 0 ; i < length ; ++i )
     {
-        section = section_->data;
+        section = sections[i];
 
         if ( ! j4status_section_is_dirty(section) )
             goto print;
@@ -216,6 +333,13 @@ _j4status_debug_send_line(J4statusPluginContext *context, J4statusOutputPluginSt
     return g_data_output_stream_put_string(stream->out, context->line->str, NULL, error);
 }
 
+static gboolean
+_j4status_debug_get_line(J4statusPluginContext *context, GPtrArray *chunks)
+{
+    g_ptr_array_add(chunks, g_bytes_new(context->line->str, context->line->len));
+    return TRUE;
+}
+
 J4STATUS_EXPORT void
 j4status_output_plugin(J4statusOutputPluginInterface *interface)
 {
@@ -225,6 +349,10 @@ j4status_output_plugin(J4statusOutputPluginInterface *interface)
     libj4status_output_plugin_interface_add_stream_new_callback(interface, _j4status_debug_stream_new);
     libj4status_output_plugin_interface_add_stream_free_callback(interface, _j4status_debug_stream_free);
 
-    libj4status_output_plugin_interface_add_generate_line_callback(interface, _j4status_debug_generate_line);
+    libj4status_output_plugin_interface_add_send_header_callback(interface, _j4status_debug_send_header);
+    libj4status_output_plugin_interface_add_generate_line_array_callback(interface, _j4status_debug_generate_line);
     libj4status_output_plugin_interface_add_send_line_callback(interface, _j4status_debug_send_line);
+    libj4status_output_plugin_interface_add_get_line_callback(interface, _j4status_debug_get_line);
+
+    libj4status_output_plugin_interface_add_trace_callback(interface, _j4status_debug_trace);
 }
@@ -32,13 +32,39 @@
 
 #include "j4status-plugin-output.h"
 
+#define DEFAULT_MIN_INTERVAL 1000
+#define VALUE_SEPARATOR '\037'
+
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     J4statusColour colours[_J4STATUS_STATE_SIZE];
     gboolean align;
+    gint64 min_interval;
     EventcConnection *eventc;
+    struct {
+        guint64 sent;
+        guint64 unchanged;
+        guint64 coalesced;
+    } stats;
 };
 
+/*
+ * One event per section, so that its identity stays the same,
+ * and what we last sent in it, to skip no-op sends
+ */
+typedef struct {
+    J4statusPluginContext *context;
+    J4statusSection *section;
+    EventdEvent *event;
+    gboolean sent;
+    gchar *value;
+    gchar *colour;
+    gchar *state_colour;
+    J4statusState state;
+    gint64 last;
+    guint timeout;
+} J4statusEvpSection;
+
 struct _J4statusOutputPluginStream {
     J4statusPluginContext *context;
     J4statusCoreStream *stream;
@@ -58,72 +84,218 @@ _j4status_evp_stream_free(G_GNUC_UNUSED J4statusPluginContext *context, G_GNUC_U
 }
 
 static void
-_j4status_evp_generate_line(J4statusPluginContext *context, GList *sections)
+_j4status_evp_section_free(gpointer data)
 {
-    GList *section_;
-    J4statusSection *section;
-    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    J4statusEvpSection *self = data;
+
+    if ( self->timeout > 0 )
+        g_source_remove(self->timeout);
+
+    g_free(self->state_colour);
+    g_free(self->colour);
+    g_free(self->value);
+
+    if ( self->event != NULL )
+        eventd_event_unref(self->event);
+
+    g_slice_free(J4statusEvpSection, self);
+}
+
+/* Returns TRUE if the string changed, taking care of the copy */
+static gboolean
+_j4status_evp_section_update_string(gchar **old, const gchar *new)
+{
+    if ( g_strcmp0(*old, new) == 0 )
+        return FALSE;
+
+    g_free(*old);
+    *old = g_strdup(new);
+    return TRUE;
+}
+
+static void
+_j4status_evp_section_add_value(J4statusEvpSection *self)
+{
+    GVariantBuilder builder;
+    const gchar *s = self->value, *c;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_STRING_ARRAY);
+    while ( ( c = strchr(s, VALUE_SEPARATOR) ) != NULL )
     {
-        section = section_->data;
-        if ( ! j4status_section_is_dirty(section) )
-            continue;
+        g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strndup(s, c - s)));
+        s = c + 1;
+    }
+    g_variant_builder_add_value(&builder, g_variant_new_string(s));
 
-        const gchar *value;
-        value = j4status_section_get_value(section);
-        if ( value == NULL )
-            continue;
+    eventd_event_add_data(self->event, g_strdup("value"), g_variant_builder_end(&builder));
+}
 
-        J4statusColour colour = {0};
+/*
+ * Events cannot drop a key, so a key going away means a new event
+ * with the same UUID, carrying the whole state without it
+ */
+static void
+_j4status_evp_section_new_event(J4statusEvpSection *self)
+{
+    J4statusSection *section = self->section;
+    EventdEvent *event;
 
-        EventdEvent *event;
-        event = j4status_section_get_output_user_data(section);
-        if ( event == NULL )
-        {
-            event = eventd_event_new("j4status", j4status_section_get_name(section));
-            j4status_section_set_output_user_data(section, event, (GDestroyNotify) eventd_event_unref);
-
-            eventd_event_add_data_string(event, g_strdup("instance"), g_strdup(j4status_section_get_instance(section)));
-
-            const gchar *label;
-            label = j4status_section_get_label(section);
-            if ( label != NULL )
-            {
-                eventd_event_add_data_string(event, g_strdup("label"), g_strdup(label));
-                colour = j4status_section_get_label_colour(section);
-                if ( colour.set )
-                    eventd_event_add_data_string(event, g_strdup("label-colour"), g_strdup(j4status_colour_to_hex(colour)));
-            }
-        }
+    if ( self->event == NULL )
+        event = eventd_event_new("j4status", j4status_section_get_name(section));
+    else
+    {
+        event = eventd_event_new_for_uuid_string(eventd_event_get_uuid(self->event), "j4status", j4status_section_get_name(section));
+        eventd_event_unref(self->event);
+    }
+    self->event = event;
+
+    eventd_event_add_data_string(event, g_strdup("instance"), g_strdup(j4status_section_get_instance(section)));
+
+    const gchar *label;
+    label = j4status_section_get_label(section);
+    if ( label != NULL )
+    {
+        eventd_event_add_data_string(event, g_strdup("label"), g_strdup(label));
+        J4statusColour colour = j4status_section_get_label_colour(section);
+        if ( colour.set )
+            eventd_event_add_data_string(event, g_strdup("label-colour"), g_strdup(j4status_colour_to_hex(colour)));
+    }
 
-        GVariantBuilder builder;
-        const gchar *s = value, *c ;
-        g_variant_builder_init(&builder, G_VARIANT_TYPE_STRING_ARRAY);
-        while ( ( c = g_utf8_strchr(s, -1, '') ) != NULL )
+    if ( self->value != NULL )
+        _j4status_evp_section_add_value(self);
+    if ( self->colour != NULL )
+        eventd_event_add_data_string(event, g_strdup("colour"), g_strdup(self->colour));
+    if ( self->state_colour != NULL )
+        eventd_event_add_data_string(event, g_strdup("state-colour"), g_strdup(self->state_colour));
+    eventd_event_add_data(event, g_strdup("state"), g_variant_new_uint32(self->state & ~J4STATUS_STATE_FLAGS));
+    eventd_event_add_data(event, g_strdup("urgent"), g_variant_new_boolean(self->state & J4STATUS_STATE_URGENT));
+}
+
+static void
+_j4status_evp_section_send(J4statusEvpSection *self)
+{
+    J4statusPluginContext *context = self->context;
+    J4statusSection *section = self->section;
+    J4statusColour colour;
+
+    if ( self->timeout > 0 )
+        g_source_remove(self->timeout);
+    self->timeout = 0;
+
+    const gchar *value;
+    value = j4status_section_get_value(section);
+    if ( value == NULL )
+        return;
+
+    J4statusState state = j4status_section_get_state(section);
+    gboolean value_changed, colour_changed, state_colour_changed, state_changed;
+
+    value_changed = _j4status_evp_section_update_string(&self->value, value);
+    colour = j4status_section_get_colour(section);
+    colour_changed = _j4status_evp_section_update_string(&self->colour, colour.set ? j4status_colour_to_hex(colour) : NULL);
+    colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
+    state_colour_changed = _j4status_evp_section_update_string(&self->state_colour, colour.set ? j4status_colour_to_hex(colour) : NULL);
+    state_changed = ( self->state != state );
+    self->state = state;
+
+    if ( self->sent && ( ! ( value_changed || colour_changed || state_colour_changed || state_changed ) ) )
+    {
+        ++context->stats.unchanged;
+        return;
+    }
+
+    if ( ( self->event == NULL ) || ( colour_changed && ( self->colour == NULL ) ) || ( state_colour_changed && ( self->state_colour == NULL ) ) )
+        _j4status_evp_section_new_event(self);
+    else
+    {
+        if ( value_changed )
+            _j4status_evp_section_add_value(self);
+        if ( colour_changed )
+            eventd_event_add_data_string(self->event, g_strdup("colour"), g_strdup(self->colour));
+        if ( state_colour_changed )
+            eventd_event_add_data_string(self->event, g_strdup("state-colour"), g_strdup(self->state_colour));
+        if ( state_changed )
         {
-            g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strndup(s, c - s)));
-            s = g_utf8_next_char(c);
+            eventd_event_add_data(self->event, g_strdup("state"), g_variant_new_uint32(state & ~J4STATUS_STATE_FLAGS));
+            eventd_event_add_data(self->event, g_strdup("urgent"), g_variant_new_boolean(state & J4STATUS_STATE_URGENT));
         }
-        g_variant_builder_add_value(&builder, g_variant_new_string(s));
+    }
 
-        eventd_event_add_data(event, g_strdup("value"), g_variant_builder_end(&builder));
+    self->sent = TRUE;
+    self->last = g_get_monotonic_time();
+    ++context->stats.sent;
 
-        J4statusState state = j4status_section_get_state(section);
-        colour = j4status_section_get_colour(section);
-        if ( colour.set )
-            eventd_event_add_data_string(event, g_strdup("colour"), g_strdup(j4status_colour_to_hex(colour)));
-        colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-        if ( colour.set )
-            eventd_event_add_data_string(event, g_strdup("state-colour"), g_strdup(j4status_colour_to_hex(colour)));
+    eventc_connection_send_event(context->eventc, self->event, NULL);
+}
+
+static gboolean
+_j4status_evp_section_timeout(gpointer user_data)
+{
+    J4statusEvpSection *self = user_data;
+
+    self->timeout = 0;
+    _j4status_evp_section_send(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * A section gets at most one event per interval,
+ * later updates are merged in a single event at the end of it
+ * Urgent sections go through right away
+ */
+static void
+_j4status_evp_update_section(J4statusPluginContext *context, J4statusSection *section)
+{
+    j4status_section_set_cache(section, NULL);
+
+    if ( j4status_section_get_value(section) == NULL )
+        return;
+
+    J4statusEvpSection *self;
+    self = j4status_section_get_output_user_data(section);
+    if ( self == NULL )
+    {
+        self = g_slice_new0(J4statusEvpSection);
+        self->context = context;
+        self->section = section;
+        j4status_section_set_output_user_data(section, self, _j4status_evp_section_free);
+    }
+
+    gint64 wait = 0;
+    if ( self->sent && ( context->min_interval > 0 ) && ( ! ( j4status_section_get_state(section) & J4STATUS_STATE_URGENT ) ) )
+        wait = self->last + context->min_interval - g_get_monotonic_time();
 
-        eventd_event_add_data(event, g_strdup("state"), g_variant_new_uint32(state & ~J4STATUS_STATE_FLAGS));
-        eventd_event_add_data(event, g_strdup("urgent"), g_variant_new_boolean(state & J4STATUS_STATE_URGENT));
+    if ( wait <= 0 )
+    {
+        _j4status_evp_section_send(self);
+        return;
+    }
 
-        eventc_connection_send_event(context->eventc, event, NULL);
+    if ( self->timeout > 0 )
+        ++context->stats.coalesced;
+    else
+        self->timeout = g_timeout_add(( wait + 999 ) / 1000, _j4status_evp_section_timeout, self);
+}
 
-        j4status_section_set_cache(section, NULL);
+static void
+_j4status_evp_generate_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( j4status_section_is_dirty(sections[i]) )
+            _j4status_evp_update_section(context, sections[i]);
     }
 }
 
+static void
+_j4status_evp_generate_line_incremental(J4statusPluginContext *context, G_GNUC_UNUSED J4statusSection * const *sections, G_GNUC_UNUSED gsize length, J4statusSection * const *dirty, gsize dirty_length)
+{
+    gsize i;
+    for ( i = 0 ; i < dirty_length ; ++i )
+        _j4status_evp_update_section(context, dirty[i]);
+}
+
 static void
 _j4status_evp_update_colour(J4statusColour *colour, GKeyFile *key_file, gchar *name)
 {
@@ -163,7 +335,9 @@ _j4status_evp_init(J4statusCoreInterface *core)
     context->colours[J4STATUS_STATE_GOOD].green = 0xff;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("EvP");
+    key_file = j4status_config_get_group("EvP");
+
+    context->min_interval = DEFAULT_MIN_INTERVAL * 1000;
 
     if ( key_file != NULL )
     {
@@ -173,10 +347,15 @@ _j4status_evp_init(J4statusCoreInterface *core)
         _j4status_evp_update_colour(&context->colours[J4STATUS_STATE_BAD], key_file, "BadColour");
         _j4status_evp_update_colour(&context->colours[J4STATUS_STATE_AVERAGE], key_file, "AverageColour");
         _j4status_evp_update_colour(&context->colours[J4STATUS_STATE_GOOD], key_file, "GoodColour");
+
+        GError *error = NULL;
+        gint64 min_interval;
+        min_interval = g_key_file_get_int64(key_file, "EvP", "MinInterval", &error);
+        if ( error == NULL )
+            context->min_interval = MAX(min_interval, 0) * 1000;
+        g_clear_error(&error);
     }
 
-    if ( key_file != NULL )
-        g_key_file_free(key_file);
 
     GError *error = NULL;
 
@@ -189,9 +368,19 @@ _j4status_evp_init(J4statusCoreInterface *core)
     return context;
 }
 
+static void
+_j4status_evp_dump_stats(J4statusPluginContext *context, GKeyFile *key_file, const gchar *group)
+{
+    g_key_file_set_uint64(key_file, group, "Events", context->stats.sent);
+    g_key_file_set_uint64(key_file, group, "UnchangedUpdates", context->stats.unchanged);
+    g_key_file_set_uint64(key_file, group, "CoalescedUpdates", context->stats.coalesced);
+}
+
 static void
 _j4status_evp_uninit(J4statusPluginContext *context)
 {
+    g_debug("Sent %" G_GUINT64_FORMAT " events, %" G_GUINT64_FORMAT " updates without changes, %" G_GUINT64_FORMAT " updates coalesced", context->stats.sent, context->stats.unchanged, context->stats.coalesced);
+
     eventc_connection_close(context->eventc, NULL);
     g_object_unref(context->eventc);
 
@@ -207,5 +396,8 @@ j4status_output_plugin(J4statusOutputPluginInterface *interface)
     libj4status_output_plugin_interface_add_stream_new_callback(interface, _j4status_evp_stream_new);
     libj4status_output_plugin_interface_add_stream_free_callback(interface, _j4status_evp_stream_free);
 
-    libj4status_output_plugin_interface_add_generate_line_callback(interface, _j4status_evp_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_array_callback(interface, _j4status_evp_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_incremental_callback(interface, _j4status_evp_generate_line_incremental);
+
+    libj4status_output_plugin_interface_add_dump_stats_callback(interface, _j4status_evp_dump_stats);
 }
@@ -29,28 +29,46 @@
 
 #include "j4status-plugin-output.h"
 
-typedef struct {
-    gchar start[28];
-    gchar end[5];
-} ColourStr;
+#define COLOUR_RESET "\e[0m"
+#define COLOUR_URGENT "\e[5m\a"
 
-#define COLOUR_STR(n) ColourStr n = { .start = { '\0' }, .end = { '\e', '[', '0', 'm', '\0' } }; /* strlen("\e[38;5;xxxm\e[38;5;xxxm\e[5m\x07") */
-#define MAX_LINE 256
+static const gchar _j4status_flat_spaces[] = "                                ";
 
 struct _J4statusPluginContext {
     J4statusCoreInterface *core;
     gchar *label_separator;
+    gsize label_separator_length;
     J4statusColour colours[_J4STATUS_STATE_SIZE];
+    gchar *colours_escape[_J4STATUS_STATE_SIZE];
     gboolean back_colours;
+    gboolean truecolour;
     gboolean align;
+    gboolean redraw;
+    guint terminals;
+    gchar digits[256][3];
+    GString *section;
     GString *line;
+    GArray *segments;
 };
 
+/* Where each section is in the line, which outlives the section caches */
+typedef struct {
+    gsize offset;
+    gsize length;
+} J4statusFlatSegment;
+
+typedef struct {
+    gchar *text;
+    gsize length;
+    gsize width;
+} J4statusFlatDrawnSection;
+
 struct _J4statusOutputPluginStream {
     J4statusPluginContext *context;
     J4statusCoreStream *stream;
     GDataInputStream *in;
     GDataOutputStream *out;
+    GArray *drawn;
 };
 
 static void
@@ -101,12 +119,27 @@ _j4status_flat_stream_new(J4statusPluginContext *context, J4statusCoreStream *co
 
     g_data_input_stream_read_line_async(stream->in, G_PRIORITY_DEFAULT, NULL, _j4status_flat_stream_read_callback, stream);
 
+    if ( context->redraw && j4status_core_stream_is_terminal(context->core, core_stream) )
+    {
+        stream->drawn = g_array_new(FALSE, FALSE, sizeof(J4statusFlatDrawnSection));
+        ++context->terminals;
+    }
+
     return stream;
 }
 
 static void
 _j4status_flat_stream_free(J4statusPluginContext *context, J4statusOutputPluginStream *stream)
 {
+    if ( stream->drawn != NULL )
+    {
+        guint i;
+        for ( i = 0 ; i < stream->drawn->len ; ++i )
+            g_free(g_array_index(stream->drawn, J4statusFlatDrawnSection, i).text);
+        g_array_free(stream->drawn, TRUE);
+        --context->terminals;
+    }
+
     g_object_unref(stream->out);
     g_object_unref(stream->in);
 
@@ -114,119 +147,312 @@ _j4status_flat_stream_free(J4statusPluginContext *context, J4statusOutputPluginS
 }
 
 static void
-_j4status_flat_set_colour(ColourStr *out, J4statusColour colour, J4statusColour back_colour, gboolean important)
+_j4status_flat_append_colour(J4statusPluginContext *context, GString *buffer, J4statusColour colour, gboolean background)
 {
-    gsize o = 0;
-    if ( colour.set )
-        o += g_sprintf(out->start, "\e[38;5;%03hum", 16 + ( ( colour.red / 51 ) * 36 ) + ( ( colour.green / 51 ) * 6 ) + ( colour.blue / 51 ));
-    if ( back_colour.set )
-        o += g_sprintf(out->start + o, "\e[48;5;%03hum", 16 + ( ( back_colour.red / 51 ) * 36 ) + ( ( back_colour.green / 51 ) * 6 ) + ( back_colour.blue / 51 ));
-    if ( important )
-        g_sprintf(out->start + o, "\e[5m\a");
-    else if ( ( ! colour.set ) && ( ! back_colour.set ) )
-        out->end[0] = '\0';
+    if ( ! colour.set )
+        return;
+
+    g_string_append_len(buffer, background ? "\e[48;" : "\e[38;", strlen("\e[38;"));
+    if ( context->truecolour )
+    {
+        g_string_append_len(buffer, "2;", strlen("2;"));
+        g_string_append_len(buffer, context->digits[colour.red], 3);
+        g_string_append_c(buffer, ';');
+        g_string_append_len(buffer, context->digits[colour.green], 3);
+        g_string_append_c(buffer, ';');
+        g_string_append_len(buffer, context->digits[colour.blue], 3);
+    }
+    else
+    {
+        g_string_append_len(buffer, "5;", strlen("5;"));
+        g_string_append_len(buffer, context->digits[16 + ( ( colour.red / 51 ) * 36 ) + ( ( colour.green / 51 ) * 6 ) + ( colour.blue / 51 )], 3);
+    }
+    g_string_append_c(buffer, 'm');
 }
 
 static void
-_j4status_flat_generate_line(J4statusPluginContext *context, GList *sections)
+_j4status_flat_append_spaces(GString *buffer, gsize length)
 {
-    g_string_truncate(context->line, 0);
-    GList *section_;
-    J4statusSection *section;
-    gboolean first = TRUE;
-    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    while ( length > 0 )
     {
-        section = section_->data;
-        const gchar *cache;
-        if ( j4status_section_is_dirty(section) )
+        gsize l = MIN(length, sizeof(_j4status_flat_spaces) - 1);
+        g_string_append_len(buffer, _j4status_flat_spaces, l);
+        length -= l;
+    }
+}
+
+static void
+_j4status_flat_update_section(J4statusPluginContext *context, J4statusSection *section)
+{
+    const gchar *value;
+    value = j4status_section_get_value(section);
+    if ( value == NULL )
+    {
+        j4status_section_set_cache(section, NULL);
+        return;
+    }
+
+    GString *buffer = context->section;
+    g_string_truncate(buffer, 0);
+
+    const gchar *label;
+    label = j4status_section_get_label(section);
+    if ( label != NULL )
+    {
+        J4statusColour label_colour = j4status_section_get_label_colour(section);
+        _j4status_flat_append_colour(context, buffer, label_colour, FALSE);
+        g_string_append(buffer, label);
+        if ( label_colour.set )
+            g_string_append_len(buffer, COLOUR_RESET, strlen(COLOUR_RESET));
+        g_string_append_len(buffer, context->label_separator, context->label_separator_length);
+    }
+
+    gsize l = 0, r = 0;
+    if ( context->align )
+    {
+        gint64 max_width;
+        max_width = j4status_section_get_max_width(section);
+
+        gsize width = j4status_section_get_value_width(section);
+        if ( ( max_width < 0 ) && ( (gsize) -max_width > width ) )
         {
-            gchar *new_cache = NULL;
-            const gchar *value;
-            value = j4status_section_get_value(section);
-            if ( value != NULL )
+            gsize s = -max_width - width;
+            switch ( j4status_section_get_align(section) )
             {
-                J4statusColour colour = {0};
-                J4statusColour back_colour = {0};
-                COLOUR_STR(colour_str);
-
-
-                J4statusState state = j4status_section_get_state(section);
-                gboolean urgent = ( state & J4STATUS_STATE_URGENT );
-                colour = j4status_section_get_colour(section);
-                back_colour = j4status_section_get_background_colour(section);
-                if ( ( ! colour.set ) && ( ! back_colour.set ) )
-                {
-                    if ( context->back_colours )
-                        back_colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                    else
-                        colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                }
-                _j4status_flat_set_colour(&colour_str, colour, back_colour, urgent);
-
-                gsize s = 1, l = 0, r = 0;
-
-                if ( context->align )
-                {
-                    gint64 max_width;
-                    max_width = j4status_section_get_max_width(section);
-
-                    if ( max_width < 0 )
-                    {
-                        s = -max_width;
-                        switch ( j4status_section_get_align(section) )
-                        {
-                        case J4STATUS_ALIGN_CENTER:
-                            l = s / 2;
-                            r = ( s + 1 ) / 2;
-                        break;
-                        case J4STATUS_ALIGN_LEFT:
-                            r = s;
-                        break;
-                        case J4STATUS_ALIGN_RIGHT:
-                            l = s;
-                        break;
-                        }
-                    }
-                }
-                gchar align_left[s], align_right[s];
-                memset(align_left, ' ', l); align_left[l] = '\0';
-                memset(align_right, ' ', r); align_right[r] = '\0';
-
-                const gchar *label;
-                label = j4status_section_get_label(section);
-                if ( label != NULL )
-                {
-                    J4statusColour back_colour = {0};
-                    COLOUR_STR(label_colour_str);
-                    _j4status_flat_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour, FALSE);
-
-                    new_cache = g_strdup_printf("%s%s%s%s%s%s%s%s%s", label_colour_str.start, label, label_colour_str.end, context->label_separator, align_left, colour_str.start, value, colour_str.end, align_right);
-                }
-                else
-                    new_cache = g_strdup_printf("%s%s%s%s%s", align_left, colour_str.start, value, colour_str.end, align_right);
+            case J4STATUS_ALIGN_CENTER:
+                l = s / 2;
+                r = ( s + 1 ) / 2;
+            break;
+            case J4STATUS_ALIGN_LEFT:
+                r = s;
+            break;
+            case J4STATUS_ALIGN_RIGHT:
+                l = s;
+            break;
             }
-            j4status_section_set_cache(section, new_cache);
-            cache = new_cache;
         }
-        else
-            cache = j4status_section_get_cache(section);
+    }
+    _j4status_flat_append_spaces(buffer, l);
+
+    J4statusState state = j4status_section_get_state(section);
+    gboolean urgent = ( state & J4STATUS_STATE_URGENT );
+    J4statusColour colour = j4status_section_get_colour(section);
+    J4statusColour back_colour = j4status_section_get_background_colour(section);
+    gboolean coloured = TRUE;
+    if ( colour.set || back_colour.set )
+    {
+        _j4status_flat_append_colour(context, buffer, colour, FALSE);
+        _j4status_flat_append_colour(context, buffer, back_colour, TRUE);
+    }
+    else if ( context->colours_escape[state & ~J4STATUS_STATE_FLAGS] != NULL )
+        g_string_append(buffer, context->colours_escape[state & ~J4STATUS_STATE_FLAGS]);
+    else
+        coloured = FALSE;
+    if ( urgent )
+        g_string_append_len(buffer, COLOUR_URGENT, strlen(COLOUR_URGENT));
+
+    g_string_append(buffer, value);
+
+    if ( coloured || urgent )
+        g_string_append_len(buffer, COLOUR_RESET, strlen(COLOUR_RESET));
+    _j4status_flat_append_spaces(buffer, r);
+
+    /* Most updates do not change the rendering, keep the old cache then */
+    if ( g_strcmp0(j4status_section_get_cache(section), buffer->str) == 0 )
+        return;
+
+    j4status_section_set_cache(section, g_strndup(buffer->str, buffer->len));
+}
+
+static void
+_j4status_flat_join_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
+{
+    g_string_truncate(context->line, 0);
+    g_array_set_size(context->segments, 0);
+    gsize i;
+    gboolean first = TRUE;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        const gchar *cache;
+        cache = j4status_section_get_cache(sections[i]);
         if ( cache == NULL )
             continue;
         if ( first )
             first = FALSE;
         else
             g_string_append(context->line, " | ");
-        g_string_append(context->line, cache);
+        J4statusFlatSegment segment = { .offset = context->line->len, .length = strlen(cache) };
+        g_string_append_len(context->line, cache, segment.length);
+        g_array_append_val(context->segments, segment);
     }
     g_string_append_c(context->line, '\n');
 }
 
+static void
+_j4status_flat_generate_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( j4status_section_is_dirty(sections[i]) )
+            _j4status_flat_update_section(context, sections[i]);
+    }
+    _j4status_flat_join_line(context, sections, length);
+}
+
+static void
+_j4status_flat_generate_line_incremental(J4statusPluginContext *context, J4statusSection * const *sections, gsize length, J4statusSection * const *dirty, gsize dirty_length)
+{
+    gsize i;
+    for ( i = 0 ; i < dirty_length ; ++i )
+        _j4status_flat_update_section(context, dirty[i]);
+    _j4status_flat_join_line(context, sections, length);
+}
+
+/* Terminal cells used by a rendered section, escape sequences excluded */
+static gsize
+_j4status_flat_display_width(const gchar *text, gsize length)
+{
+    const gchar *s = text, *e = text + length;
+    gsize width = 0;
+
+    while ( s < e )
+    {
+        if ( *s == '\e' )
+        {
+            if ( ( ++s < e ) && ( *s == '[' ) )
+            {
+                while ( ( ++s < e ) && ( ( (guchar) *s < 0x40 ) || ( (guchar) *s > 0x7e ) ) );
+                if ( s < e )
+                    ++s;
+            }
+            continue;
+        }
+        if ( *s == '\a' )
+        {
+            ++s;
+            continue;
+        }
+
+        gunichar c = g_utf8_get_char_validated(s, e - s);
+        if ( c >= (gunichar) -2 )
+        {
+            ++width;
+            ++s;
+            continue;
+        }
+        if ( g_unichar_iswide(c) )
+            width += 2;
+        else if ( ! g_unichar_iszerowidth(c) )
+            ++width;
+        s = g_utf8_next_char(s);
+    }
+
+    return width;
+}
+
+/*
+ * On a terminal, we stay on the same line and only rewrite sections
+ * that changed, as long as every section keeps its width
+ */
+static gboolean
+_j4status_flat_drawn_section_equal(const J4statusFlatDrawnSection *section, const gchar *text, gsize length)
+{
+    return ( section->length == length ) && ( memcmp(section->text, text, length) == 0 );
+}
+
+static gboolean
+_j4status_flat_send_line_redraw(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
+{
+    GArray *segments = context->segments;
+    GArray *drawn = stream->drawn;
+    gsize widths[segments->len + 1];
+    gboolean full = ( drawn->len != segments->len ) || ( drawn->len == 0 );
+    guint i;
+
+    for ( i = 0 ; i < segments->len ; ++i )
+    {
+        J4statusFlatSegment *segment = &g_array_index(segments, J4statusFlatSegment, i);
+        const gchar *text = context->line->str + segment->offset;
+        J4statusFlatDrawnSection *old = ( i < drawn->len ) ? &g_array_index(drawn, J4statusFlatDrawnSection, i) : NULL;
+        if ( ( old != NULL ) && _j4status_flat_drawn_section_equal(old, text, segment->length) )
+            widths[i] = old->width;
+        else
+        {
+            widths[i] = _j4status_flat_display_width(text, segment->length);
+            if ( ( old == NULL ) || ( old->width != widths[i] ) )
+                full = TRUE;
+        }
+    }
+
+    GString *buffer = context->section;
+    g_string_truncate(buffer, 0);
+
+    if ( full )
+    {
+        g_string_append_c(buffer, '\r');
+        g_string_append_len(buffer, context->line->str, context->line->len - 1);
+        g_string_append_len(buffer, "\e[K", strlen("\e[K"));
+
+        for ( i = 0 ; i < drawn->len ; ++i )
+            g_free(g_array_index(drawn, J4statusFlatDrawnSection, i).text);
+        g_array_set_size(drawn, segments->len);
+        for ( i = 0 ; i < segments->len ; ++i )
+        {
+            J4statusFlatSegment *segment = &g_array_index(segments, J4statusFlatSegment, i);
+            J4statusFlatDrawnSection *section = &g_array_index(drawn, J4statusFlatDrawnSection, i);
+            section->text = g_strndup(context->line->str + segment->offset, segment->length);
+            section->length = segment->length;
+            section->width = widths[i];
+        }
+    }
+    else
+    {
+        gsize column = 0;
+        for ( i = 0 ; i < segments->len ; ++i )
+        {
+            J4statusFlatSegment *segment = &g_array_index(segments, J4statusFlatSegment, i);
+            const gchar *text = context->line->str + segment->offset;
+            J4statusFlatDrawnSection *section = &g_array_index(drawn, J4statusFlatDrawnSection, i);
+            if ( ! _j4status_flat_drawn_section_equal(section, text, segment->length) )
+            {
+                g_string_append_c(buffer, '\r');
+                if ( column > 0 )
+                    g_string_append_printf(buffer, "\e[%" G_GSIZE_FORMAT "C", column);
+                g_string_append_len(buffer, text, segment->length);
+
+                g_free(section->text);
+                section->text = g_strndup(text, segment->length);
+                section->length = segment->length;
+            }
+            column += section->width + strlen(" | ");
+        }
+    }
+
+    if ( buffer->len == 0 )
+        return TRUE;
+    return g_data_output_stream_put_string(stream->out, buffer->str, NULL, error);
+}
+
 static gboolean
 _j4status_flat_send_line(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
 {
+    if ( stream->drawn != NULL )
+        return _j4status_flat_send_line_redraw(context, stream, error);
     return g_data_output_stream_put_string(stream->out, context->line->str, NULL, error);
 }
 
+static gboolean
+_j4status_flat_get_line(J4statusPluginContext *context, GPtrArray *chunks)
+{
+    if ( context->terminals > 0 )
+        /* Each terminal gets its own redraw */
+        return FALSE;
+
+    g_ptr_array_add(chunks, g_bytes_new(context->line->str, context->line->len));
+    return TRUE;
+}
+
 static void
 _j4status_flat_update_colour(J4statusColour *colour, GKeyFile *key_file, gchar *name)
 {
@@ -250,18 +476,22 @@ _j4status_flat_init(J4statusCoreInterface *core)
     gboolean use_colours = FALSE;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Flat");
+    key_file = j4status_config_get_group("Flat");
+    const gchar *colour_term = g_getenv("COLORTERM");
+    context->truecolour = ( g_strcmp0(colour_term, "truecolor") == 0 ) || ( g_strcmp0(colour_term, "24bit") == 0 );
+
     if ( key_file != NULL )
     {
         context->align = g_key_file_get_boolean(key_file, "Flat", "Align", NULL);
         context->label_separator = g_key_file_get_string(key_file, "Flat", "LabelSeparator", NULL);
         use_colours = g_key_file_get_boolean(key_file, "Flat", "UseColours", NULL);
         context->back_colours = g_key_file_get_boolean(key_file, "Flat", "ColoursOnBackground", NULL);
+        context->redraw = g_key_file_get_boolean(key_file, "Flat", "IncrementalRedraw", NULL);
     }
 
     if (
         use_colours &&
-        ( g_str_has_suffix(g_getenv("TERM"), "-256color") || g_str_has_suffix(g_getenv("TERM"), "-256colour") )
+        ( context->truecolour || g_str_has_suffix(g_getenv("TERM"), "-256color") || g_str_has_suffix(g_getenv("TERM"), "-256colour") )
         )
     {
         context->colours[J4STATUS_STATE_UNAVAILABLE].set = TRUE;
@@ -286,11 +516,29 @@ _j4status_flat_init(J4statusCoreInterface *core)
 
     if ( context->label_separator == NULL )
         context->label_separator = g_strdup(": ");
+    context->label_separator_length = strlen(context->label_separator);
 
-    if ( key_file != NULL )
-        g_key_file_free(key_file);
+    guint i;
+    for ( i = 0 ; i < G_N_ELEMENTS(context->digits) ; ++i )
+    {
+        context->digits[i][0] = '0' + ( i / 100 );
+        context->digits[i][1] = '0' + ( ( i / 10 ) % 10 );
+        context->digits[i][2] = '0' + ( i % 10 );
+    }
+
+    /* Escape sequences for state colours are built once for all */
+    context->section = g_string_sized_new(256);
+    for ( i = 0 ; i < _J4STATUS_STATE_SIZE ; ++i )
+    {
+        if ( ! context->colours[i].set )
+            continue;
+        g_string_truncate(context->section, 0);
+        _j4status_flat_append_colour(context, context->section, context->colours[i], context->back_colours);
+        context->colours_escape[i] = g_strndup(context->section->str, context->section->len);
+    }
 
     context->line = g_string_new("");
+    context->segments = g_array_new(FALSE, FALSE, sizeof(J4statusFlatSegment));
 
     return context;
 }
@@ -298,8 +546,13 @@ _j4status_flat_init(J4statusCoreInterface *core)
 static void
 _j4status_flat_uninit(J4statusPluginContext *context)
 {
+    g_array_free(context->segments, TRUE);
     g_string_free(context->line, TRUE);
+    g_string_free(context->section, TRUE);
 
+    guint i;
+    for ( i = 0 ; i < _J4STATUS_STATE_SIZE ; ++i )
+        g_free(context->colours_escape[i]);
     g_free(context->label_separator);
 
     g_free(context);
@@ -314,6 +567,8 @@ j4status_output_plugin(J4statusOutputPluginInterface *interface)
     libj4status_output_plugin_interface_add_stream_new_callback(interface, _j4status_flat_stream_new);
     libj4status_output_plugin_interface_add_stream_free_callback(interface, _j4status_flat_stream_free);
 
-    libj4status_output_plugin_interface_add_generate_line_callback(interface, _j4status_flat_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_array_callback(interface, _j4status_flat_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_incremental_callback(interface, _j4status_flat_generate_line_incremental);
     libj4status_output_plugin_interface_add_send_line_callback(interface, _j4status_flat_send_line);
+    libj4status_output_plugin_interface_add_get_line_callback(interface, _j4status_flat_get_line);
 }
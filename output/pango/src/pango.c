@@ -27,6 +27,10 @@
 #include <glib.h>
 #include <glib/gprintf.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
 #include "j4status-plugin-output.h"
 
 typedef struct {
@@ -42,6 +46,15 @@ struct _J4statusPluginContext {
     J4statusColour colours[_J4STATUS_STATE_SIZE];
     gboolean align;
     GByteArray *line;
+    struct {
+        guint interval;
+        guint frames;
+        guint64 generation;
+        gboolean send;
+        GPtrArray *sections;
+        GPtrArray *visible;
+        GByteArray *line;
+    } delta;
 };
 
 struct _J4statusOutputPluginStream {
@@ -49,8 +62,120 @@ struct _J4statusOutputPluginStream {
     J4statusCoreStream *stream;
     GDataInputStream *in;
     GOutputStream *out;
+    guint64 generation;
+};
+
+typedef struct {
+    gchar *value;
+    gchar *escaped;
+    gboolean changed;
+} J4statusPangoSection;
+
+static const gchar * const _j4status_pango_escapes[256] = {
+    ['&'] = "&amp;",
+    ['<'] = "&lt;",
+    ['>'] = "&gt;",
+    ['\''] = "&apos;",
+    ['"'] = "&quot;",
 };
 
+/* Returns the length of the leading run of characters not needing escaping */
+static gsize
+_j4status_pango_escape_scan(const guchar *string, gsize length)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i apos = _mm_set1_epi8('\'');
+    const __m128i quot = _mm_set1_epi8('"');
+    for ( ; i + 16 <= length ; i += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) ( string + i ));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, apos)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, gt)), _mm_cmpeq_epi8(chunk, quot)));
+        guint32 mask = _mm_movemask_epi8(special);
+        if ( mask != 0 )
+            return i + __builtin_ctz(mask);
+    }
+#endif /* __SSE2__ */
+
+    for ( ; i < length ; ++i )
+    {
+        if ( _j4status_pango_escapes[string[i]] != NULL )
+            break;
+    }
+
+    return i;
+}
+
+/* Returns NULL if there is nothing to escape */
+static gchar *
+_j4status_pango_escape(const gchar *string)
+{
+    const guchar *s = (const guchar *) string;
+    gsize length = strlen(string);
+    gsize i;
+
+    i = _j4status_pango_escape_scan(s, length);
+    if ( i == length )
+        return NULL;
+
+    GString *escaped;
+    escaped = g_string_sized_new(length + 16);
+    g_string_append_len(escaped, string, i);
+    while ( i < length )
+    {
+        g_string_append(escaped, _j4status_pango_escapes[s[i]]);
+        ++i;
+
+        gsize clean;
+        clean = _j4status_pango_escape_scan(s + i, length - i);
+        g_string_append_len(escaped, string + i, clean);
+        i += clean;
+    }
+
+    return g_string_free(escaped, FALSE);
+}
+
+static void
+_j4status_pango_section_free(gpointer data)
+{
+    J4statusPangoSection *self = data;
+
+    g_free(self->escaped);
+    g_free(self->value);
+
+    g_slice_free(J4statusPangoSection, self);
+}
+
+/* The escaped value is kept until the value changes */
+static const gchar *
+_j4status_pango_section_get_escaped_value(J4statusSection *section, const gchar *value)
+{
+    J4statusPangoSection *self;
+    self = j4status_section_get_output_user_data(section);
+    if ( self == NULL )
+    {
+        self = g_slice_new0(J4statusPangoSection);
+        j4status_section_set_output_user_data(section, self, _j4status_pango_section_free);
+    }
+    self->changed = TRUE;
+
+    if ( g_strcmp0(self->value, value) != 0 )
+    {
+        g_free(self->escaped);
+        g_free(self->value);
+        self->value = g_strdup(value);
+        self->escaped = _j4status_pango_escape(value);
+    }
+
+    return ( self->escaped != NULL ) ? self->escaped : self->value;
+}
+
 static void
 _j4status_pango_stream_read_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
 {
@@ -93,6 +218,8 @@ _j4status_pango_stream_new(J4statusPluginContext *context, J4statusCoreStream *c
     stream = g_slice_new0(J4statusOutputPluginStream);
     stream->context = context;
     stream->stream = core_stream;
+    /* Will get a full frame first */
+    stream->generation = context->delta.generation - 1;
 
     stream->out = j4status_core_stream_get_output_stream(stream->context->core, stream->stream);
     stream->in = g_data_input_stream_new(j4status_core_stream_get_input_stream(stream->context->core, stream->stream));
@@ -135,106 +262,215 @@ _j4status_pango_set_colour(ColourStr *out, J4statusColour colour, J4statusColour
     g_snprintf(out->start + o, l - o, ">");
 }
 
-#define byte_append(b) G_STMT_START { guint8 b_ = (b); g_byte_array_append(context->line, &b_, 1); } G_STMT_END
-static void
-_j4status_pango_generate_line(J4statusPluginContext *context, GList *sections)
+#define byte_append(a, b) G_STMT_START { guint8 b_ = (b); g_byte_array_append((a), &b_, 1); } G_STMT_END
+static gboolean
+_j4status_pango_update_section(J4statusPluginContext *context, J4statusSection *section)
 {
-    g_byte_array_set_size(context->line, 0);
-    GList *section_;
-    J4statusSection *section;
     gboolean urgent = FALSE;
-    for ( section_ = sections ; section_ != NULL ; section_ = g_list_next(section_) )
+    gchar *new_cache = NULL;
+    const gchar *value;
+    value = j4status_section_get_value(section);
+    if ( value != NULL )
     {
-        section = section_->data;
-        const gchar *cache;
-        if ( j4status_section_is_dirty(section) )
-        {
-            gchar *new_cache = NULL;
-            const gchar *value;
-            value = j4status_section_get_value(section);
-            if ( value != NULL )
-            {
-                J4statusColour colour = {0};
-                J4statusColour back_colour = {0};
-                COLOUR_STR(colour_str);
+        value = _j4status_pango_section_get_escaped_value(section, value);
 
+        J4statusColour colour = {0};
+        J4statusColour back_colour = {0};
+        COLOUR_STR(colour_str);
 
-                J4statusState state = j4status_section_get_state(section);
-                urgent = urgent || ( state & J4STATUS_STATE_URGENT );
-                colour = j4status_section_get_colour(section);
-                back_colour = j4status_section_get_background_colour(section);
-                if ( ( ! colour.set ) && ( ! back_colour.set ) )
-                    colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
-                _j4status_pango_set_colour(&colour_str, colour, back_colour);
 
-                gsize s = 1, l = 0, r = 0;
+        J4statusState state = j4status_section_get_state(section);
+        urgent = ( state & J4STATUS_STATE_URGENT );
+        colour = j4status_section_get_colour(section);
+        back_colour = j4status_section_get_background_colour(section);
+        if ( ( ! colour.set ) && ( ! back_colour.set ) )
+            colour = context->colours[state & ~J4STATUS_STATE_FLAGS];
+        _j4status_pango_set_colour(&colour_str, colour, back_colour);
 
-                if ( context->align )
-                {
-                    gint64 max_width;
-                    max_width = j4status_section_get_max_width(section);
-
-                    if ( max_width < 0 )
-                    {
-                        s = -max_width;
-                        switch ( j4status_section_get_align(section) )
-                        {
-                        case J4STATUS_ALIGN_CENTER:
-                            l = s / 2;
-                            r = ( s + 1 ) / 2;
-                        break;
-                        case J4STATUS_ALIGN_LEFT:
-                            r = s;
-                        break;
-                        case J4STATUS_ALIGN_RIGHT:
-                            l = s;
-                        break;
-                        }
-                    }
-                }
-                gchar align_left[s], align_right[s];
-                memset(align_left, ' ', l); align_left[l] = '\0';
-                memset(align_right, ' ', r); align_right[r] = '\0';
+        gsize s = 1, l = 0, r = 0;
 
-                const gchar *label;
-                label = j4status_section_get_label(section);
-                if ( label != NULL )
-                {
-                    COLOUR_STR(label_colour_str);
-                    _j4status_pango_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour);
+        if ( context->align )
+        {
+            gint64 max_width;
+            max_width = j4status_section_get_max_width(section);
 
-                    new_cache = g_strdup_printf("%s%s%s%s%s%s%s%s%s", label_colour_str.start, label, label_colour_str.end, context->label_separator, align_left, colour_str.start, value, colour_str.end, align_right);
+            gsize width = j4status_section_get_value_width(section);
+            if ( ( max_width < 0 ) && ( (gsize) -max_width > width ) )
+            {
+                s = -max_width - width;
+                switch ( j4status_section_get_align(section) )
+                {
+                case J4STATUS_ALIGN_CENTER:
+                    l = s / 2;
+                    r = ( s + 1 ) / 2;
+                break;
+                case J4STATUS_ALIGN_LEFT:
+                    r = s;
+                break;
+                case J4STATUS_ALIGN_RIGHT:
+                    l = s;
+                break;
                 }
-                else
-                    new_cache = g_strdup_printf("%s%s%s%s%s", align_left, colour_str.start, value, colour_str.end, align_right);
             }
-            j4status_section_set_cache(section, new_cache);
-            cache = new_cache;
+        }
+        gchar align_left[s], align_right[s];
+        memset(align_left, ' ', l); align_left[l] = '\0';
+        memset(align_right, ' ', r); align_right[r] = '\0';
+
+        const gchar *label;
+        label = j4status_section_get_label(section);
+        if ( label != NULL )
+        {
+            COLOUR_STR(label_colour_str);
+            _j4status_pango_set_colour(&label_colour_str, j4status_section_get_label_colour(section), back_colour);
+
+            new_cache = g_strdup_printf("%s%s%s%s%s%s%s%s%s", label_colour_str.start, label, label_colour_str.end, context->label_separator, align_left, colour_str.start, value, colour_str.end, align_right);
         }
         else
-            cache = j4status_section_get_cache(section);
+            new_cache = g_strdup_printf("%s%s%s%s%s", align_left, colour_str.start, value, colour_str.end, align_right);
+    }
+    j4status_section_set_cache(section, new_cache);
+    return urgent;
+}
+
+static void
+_j4status_pango_append_string(GByteArray *line, const gchar *cache)
+{
+    guint64 cache_length, size;
+    cache_length = strlen(cache);
+    size = GUINT64_TO_BE(cache_length);
+    g_byte_array_append(line, (const guint8 *) &size, sizeof(size));
+    g_byte_array_append(line, (const guint8 *) cache, cache_length);
+}
+
+/*
+ * A delta frame holds all the sections changed since the last full frame,
+ * so a stream missing some of them is still fine
+ */
+static void
+_j4status_pango_join_delta(J4statusPluginContext *context, gboolean urgent)
+{
+    GPtrArray *sections = context->delta.sections, *visible = context->delta.visible;
+    gboolean full = ( context->delta.frames >= context->delta.interval ) || ( sections->len != visible->len );
+    guint i;
+
+    for ( i = 0 ; ( ! full ) && ( i < sections->len ) ; ++i )
+        full = ( g_ptr_array_index(sections, i) != g_ptr_array_index(visible, i) );
+
+    g_byte_array_set_size(context->delta.line, 0);
+    if ( ! full )
+    {
+        byte_append(context->delta.line, 'd');
+        for ( i = 0 ; i < sections->len ; ++i )
+        {
+            J4statusSection *section = g_ptr_array_index(sections, i);
+            J4statusPangoSection *self = j4status_section_get_output_user_data(section);
+            if ( ! self->changed )
+                continue;
+
+            guint64 index;
+            index = GUINT64_TO_BE(i);
+            byte_append(context->delta.line, 'S');
+            g_byte_array_append(context->delta.line, (const guint8 *) &index, sizeof(index));
+            _j4status_pango_append_string(context->delta.line, j4status_section_get_cache(section));
+        }
+        if ( urgent )
+            byte_append(context->delta.line, 'u');
+        byte_append(context->delta.line, '\0');
+
+        /* Not worth it */
+        full = ( context->delta.line->len >= context->line->len );
+    }
+
+    context->delta.send = ! full;
+    if ( ! full )
+    {
+        ++context->delta.frames;
+        return;
+    }
+
+    context->delta.frames = 0;
+    ++context->delta.generation;
+    context->delta.sections = visible;
+    context->delta.visible = sections;
+    for ( i = 0 ; i < sections->len ; ++i )
+    {
+        J4statusPangoSection *self = j4status_section_get_output_user_data(g_ptr_array_index(sections, i));
+        self->changed = FALSE;
+    }
+}
+
+static void
+_j4status_pango_join_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length, gboolean urgent)
+{
+    g_byte_array_set_size(context->line, 0);
+    if ( context->delta.interval > 0 )
+        g_ptr_array_set_size(context->delta.sections, 0);
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        const gchar *cache;
+        cache = j4status_section_get_cache(sections[i]);
         if ( cache == NULL )
             continue;
 
-        guint64 length, size;
-        length = strlen(cache);
-        size = GUINT64_TO_BE(length);
-        byte_append('s');
-        g_byte_array_append(context->line, (const guint8 *) &size, sizeof(size));
-        g_byte_array_append(context->line, (const guint8 *) cache, length);
-
+        byte_append(context->line, 's');
+        _j4status_pango_append_string(context->line, cache);
+        if ( context->delta.interval > 0 )
+            g_ptr_array_add(context->delta.sections, sections[i]);
     }
     if ( urgent )
-        byte_append('u');
-    byte_append('\0');
+        byte_append(context->line, 'u');
+    byte_append(context->line, '\0');
+
+    if ( context->delta.interval > 0 )
+        _j4status_pango_join_delta(context, urgent);
+}
+
+static void
+_j4status_pango_generate_line(J4statusPluginContext *context, J4statusSection * const *sections, gsize length)
+{
+    gboolean urgent = FALSE;
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( j4status_section_is_dirty(sections[i]) )
+            urgent = _j4status_pango_update_section(context, sections[i]) || urgent;
+    }
+    _j4status_pango_join_line(context, sections, length, urgent);
+}
+
+static void
+_j4status_pango_generate_line_incremental(J4statusPluginContext *context, J4statusSection * const *sections, gsize length, J4statusSection * const *dirty, gsize dirty_length)
+{
+    gboolean urgent = FALSE;
+    gsize i;
+    for ( i = 0 ; i < dirty_length ; ++i )
+        urgent = _j4status_pango_update_section(context, dirty[i]) || urgent;
+    _j4status_pango_join_line(context, sections, length, urgent);
 }
 
 static gboolean
 _j4status_pango_send_line(J4statusPluginContext *context, J4statusOutputPluginStream *stream, GError **error)
 {
+    if ( context->delta.send && ( stream->generation == context->delta.generation ) )
+        return g_output_stream_write_all(stream->out, context->delta.line->data, context->delta.line->len, NULL, NULL, error);
+
+    stream->generation = context->delta.generation;
     return g_output_stream_write_all(stream->out, context->line->data, context->line->len, NULL, NULL, error);
 }
 
+static gboolean
+_j4status_pango_get_line(J4statusPluginContext *context, GPtrArray *chunks)
+{
+    if ( context->delta.interval > 0 )
+        /* Each stream needs to know which full frame it has */
+        return FALSE;
+
+    g_ptr_array_add(chunks, g_bytes_new(context->line->data, context->line->len));
+    return TRUE;
+}
+
 static void
 _j4status_pango_update_colour(J4statusColour *colour, GKeyFile *key_file, gchar *name)
 {
@@ -266,12 +502,19 @@ _j4status_pango_init(J4statusCoreInterface *core)
     context->colours[J4STATUS_STATE_GOOD].green = 0xff;
 
     GKeyFile *key_file;
-    key_file = j4status_config_get_key_file("Pango");
+    key_file = j4status_config_get_group("Pango");
 
     if ( key_file != NULL )
     {
         context->align = g_key_file_get_boolean(key_file, "Pango", "Align", NULL);
         context->label_separator = g_key_file_get_string(key_file, "Pango", "LabelSeparator", NULL);
+
+        GError *error = NULL;
+        gint64 delta_frames;
+        delta_frames = g_key_file_get_int64(key_file, "Pango", "DeltaFrames", &error);
+        if ( error == NULL )
+            context->delta.interval = CLAMP(delta_frames, 0, G_MAXUINT);
+        g_clear_error(&error);
         _j4status_pango_update_colour(&context->colours[J4STATUS_STATE_NO_STATE], key_file, "NoStateColour");
         _j4status_pango_update_colour(&context->colours[J4STATUS_STATE_UNAVAILABLE], key_file, "UnavailableColour");
         _j4status_pango_update_colour(&context->colours[J4STATUS_STATE_BAD], key_file, "BadColour");
@@ -282,10 +525,14 @@ _j4status_pango_init(J4statusCoreInterface *core)
     if ( context->label_separator == NULL )
         context->label_separator = g_strdup(": ");
 
-    if ( key_file != NULL )
-        g_key_file_free(key_file);
 
     context->line = g_byte_array_new();
+    if ( context->delta.interval > 0 )
+    {
+        context->delta.sections = g_ptr_array_new();
+        context->delta.visible = g_ptr_array_new();
+        context->delta.line = g_byte_array_new();
+    }
 
     return context;
 }
@@ -293,6 +540,12 @@ _j4status_pango_init(J4statusCoreInterface *core)
 static void
 _j4status_pango_uninit(J4statusPluginContext *context)
 {
+    if ( context->delta.interval > 0 )
+    {
+        g_byte_array_unref(context->delta.line);
+        g_ptr_array_unref(context->delta.visible);
+        g_ptr_array_unref(context->delta.sections);
+    }
     g_byte_array_unref(context->line);
 
     g_free(context->label_separator);
@@ -310,6 +563,8 @@ j4status_output_plugin(J4statusOutputPluginInterface *interface)
     libj4status_output_plugin_interface_add_stream_free_callback(interface, _j4status_pango_stream_free);
 
     libj4status_output_plugin_interface_add_send_header_callback(interface, _j4status_pango_send_header);
-    libj4status_output_plugin_interface_add_generate_line_callback(interface, _j4status_pango_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_array_callback(interface, _j4status_pango_generate_line);
+    libj4status_output_plugin_interface_add_generate_line_incremental_callback(interface, _j4status_pango_generate_line_incremental);
     libj4status_output_plugin_interface_add_send_line_callback(interface, _j4status_pango_send_line);
+    libj4status_output_plugin_interface_add_get_line_callback(interface, _j4status_pango_get_line);
 }